@@ -3,26 +3,107 @@
 
 #include <SDL2/SDL.h>
 #include "i8080.h"
+#include "scheduler.h"
 
+// Input word bits: keyboard and gamepads are mapped in parallel on the same controls
+#define INPUT_LEFT   0x01
+#define INPUT_RIGHT  0x02
+#define INPUT_SHOT   0x04
+#define INPUT_START1 0x08
+#define INPUT_START2 0x10
+#define INPUT_COIN   0x20
+#define INPUT_TILT   0x40
+
+#define FRAMERATE 59.541985                         // ~60Hz Video refreshrate
+#define CYCLES_PER_FRAME (1996800 / FRAMERATE)      // ~2MHz 8080 CPU clock frequency
+#define MICROSEC_PER_FRAME (1000000 / FRAMERATE)    // 1µs emulation resolution
+
+#define MAX_HLE_ROUTINES 8                          // Natively executed ROM routines per ROM set
+
+struct hle_routine;
+struct ram_page;
+
+// ROM content and the tables derived from it, shared by a machine and its copies (copy_arcade_machine).
+// The pages are write protected when the machine is started, each instance only owns its RAM and registers.
+typedef struct {
+    uint8_t rom[ROM_SIZE];          // 0x0000 - 0x1FFF
+    uint8_t hle_entry[ROM_SIZE];    // Per ROM address: index + 1 of the HLE routine starting there
+    const struct hle_routine *hle_active[MAX_HLE_ROUTINES];  // HLE routines matching the ROM content
+    int sealed;                     // Tables built and pages write protected
+} rom_bank;
+
+// Clone pages (state_clone.h) holding the same content as the RAM pages not marked dirty in the CPU state
 typedef struct {
+    uint64_t store;                 // Serial number of the clone store of the pages (0 = none)
+    struct ram_page *pages[RAM_PAGES];
+    uint64_t ids[RAM_PAGES];        // Page content ids when they were copied, a recycled page gets a new id
+} clone_source;
+
+typedef struct arcade_system {
     Cpu_state state;                // CPU State (registers, sp, pc, memory, etc.)
-    int left;
-    int right;
-    int shot;
-    int start1;
-    int start2;
-    int coin;
-    int tilt;
+    uint8_t input;                  // Input word holding one INPUT_* bit per control
+    uint8_t input_port[3];          // Ready-made input port 0, 1 and 2 data (DIP switches and input word)
+    uint8_t input_port_dip[3];      // DIP switch and fixed bits of the input ports 0, 1 and 2
+    uint8_t input_pending;          // Input bits changed but not yet read by the game through an IN instruction
+    uint32_t input_stamp[8];        // SDL event time stamp (ms) of the last change of each input bit
     int quit;
     uint16_t ext_shift_data;        // External shift register (shift data)
     uint8_t ext_shift_offset;       // External shift register (shift amount)
     uint8_t dip_switches[8];        // The original SI hardware DIP switches
     uint8_t arcade_mode[7];         // Configure: Color, Rotate, Flip, Fullscreen, Background, 2P_Vertical_Flip and Scaling_Mode
+    uint8_t input_mode[3];          // Configure: Mid_Frame_Poll, Latency_Histogram and Latency_Probe
     char sample_filepath[10][64];   // Sound Sample filepaths
+    uint32_t rom_crc[10];           // CRC32 of the loaded ROM files to identify the ROM set
+    int rom_count;                  // Number of loaded ROM files
     uint8_t cocktail_vertical_screen_flip;  // Flip the screen vertically for a 2P SI cocktail table game
+    uint8_t sound_latch[2];         // Port 3 & 5 data of the last OUT instruction to detect the sound bit changes
+    uint8_t sound_mute;             // Sound output suppressed (e.g. for run-ahead frames)
+    uint8_t run_ahead;              // Configure: Number of frames emulated ahead of the presented frame
+    scheduler scheduler;            // Master cycle counter and timed events (interrupts, input polling)
+    uint64_t frame_count;           // Emulated video frames
+    uint8_t frame_done;             // Set by the end of screen interrupt
+    uint8_t idle_skip;              // Configure: Fast-forward wait loops and HLT to the next interrupt
+    idle_loops idle_loops;          // Wait loops detected in the ROM
+    uint8_t hle_mode;               // Configure: High level emulation of hot ROM routines (1 = on, 2 = verify)
+    uint64_t hle_cycles;            // CPU cycles executed natively
+    uint32_t hle_mismatches;        // Differences found in the verification mode
+    rom_bank *rom_bank;             // Shared ROM pages (allocated by initialize_arcade_machine)
+    uint8_t sample_profile;         // Configure: Sampling profiler interval in ms (0 = off)
+    clone_source clone_source;      // Copy-on-write clone pages matching the RAM
+    uint8_t frame_export;           // Configure: Frame slots of the shared memory frame export (0 = off)
+    uint8_t record;                 // Configure: Recording of the frames and the sound (0 = off, 1 = Y4M, 2 = PNG)
+
+    // Frontend connection (e.g. SDL), not connected (NULL) for headless use
+    void (*play_sound)(int sample_num);                                          // Sound sample output
+    void (*input_port_read)(struct arcade_system *system, uint8_t port_number);  // Input latency measurement
+    void (*poll_input)(struct arcade_system *system);                            // Mid-frame input polling
+    void (*sound_event)(struct arcade_system *system, uint8_t port_number, uint8_t port_data);  // Sound latch change
 } arcade_system;
 
-// Arcade API
+// Machine state snapshot used by the run-ahead mode
+typedef struct {
+    Cpu_state state;
+    uint16_t ext_shift_data;
+    uint8_t ext_shift_offset;
+    uint8_t sound_latch[2];
+    uint8_t cocktail_vertical_screen_flip;
+    scheduler scheduler;
+    uint64_t idle_skipped_cycles;   // Rolled back with the master cycle counter (run-ahead frames)
+    uint64_t frame_count;
+} arcade_snapshot;
+
+// Arcade machine API (no SDL dependencies)
+void initialize_arcade_machine(arcade_system *system);
+void seal_rom_bank(arcade_system *system);
+void start_arcade_machine(arcade_system *system);
+void emulate_frame(arcade_system *system);
+void copy_arcade_machine(arcade_system *to, const arcade_system *from);
+void adopt_scheduler(arcade_system *system, const scheduler *sched, const arcade_system *from);
+void release_arcade_machine(arcade_system *system);
+void save_arcade_state(arcade_system *system, arcade_snapshot *snapshot);
+void load_arcade_state(arcade_system *system, arcade_snapshot *snapshot);
+
+// Arcade API (SDL frontend)
 void initialize_arcade_system(arcade_system *system);
 void run_arcade_system(arcade_system *system);
 
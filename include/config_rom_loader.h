@@ -5,5 +5,7 @@
 
 // Configuration and ROM loading API
 void load_config_rom(arcade_system *system);
+void load_config_file(arcade_system *system, char *filename);
+uint32_t crc32(uint8_t *data, size_t size);
 
 #endif
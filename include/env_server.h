@@ -0,0 +1,73 @@
+#ifndef ENV_SERVER_H
+#define ENV_SERVER_H
+
+#include <stdint.h>
+#include "vector_env.h"
+
+// Binary protocol over a UNIX domain stream socket (host byte order): each request is a server_request followed by
+// its payload, each response a server_response followed by its payload. Observations, game states and RAM are
+// never sent over the socket, they are left in the shared memory named in server_info.
+#define SERVER_MAGIC 0x53564E49  // "INVS"
+#define SERVER_VERSION 1
+#define DEFAULT_SERVER_SOCKET "/tmp/invaders-server.sock"
+
+enum Server_command {
+    SERVER_INFO,                 // Response payload: server_info
+    SERVER_RESET,                // Reset instance argument (-1 = all)
+    SERVER_STEP,                 // Payload: one input word (INPUT_* bits) per instance, emulate one frame of each
+    SERVER_FETCH_RAM,            // Copy the RAM of all instances into the shared memory
+    SERVER_SHUTDOWN,             // Close the connection and end the server
+};
+
+enum Server_status {
+    SERVER_OK = 0,
+    SERVER_BAD_COMMAND = -1,
+    SERVER_BAD_ARGUMENT = -2,
+};
+
+typedef struct {
+    uint32_t command;
+    int32_t argument;
+    uint32_t size;               // Payload bytes
+} server_request;
+
+typedef struct {
+    int32_t status;
+    uint32_t size;               // Payload bytes
+} server_response;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;              // Instances
+    uint32_t game_states;        // 1 = game states available (known ROM set)
+    uint64_t shared_size;
+    char shared_name[64];        // POSIX shared memory object (shm_open)
+} server_info;
+
+// Start of the shared memory, the offsets are from the start of the shared memory
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t steps;              // Completed steps
+    uint64_t observations;       // count * OBSERVATION_SIZE bytes of video RAM, updated by each step and reset
+    uint64_t game_states;        // count game_state structs, updated by each step and reset
+    uint64_t ram;                // count * RAM_SIZE bytes, updated by SERVER_FETCH_RAM
+} server_memory;
+
+typedef struct {
+    vector_env *env;
+    server_memory *memory;
+    size_t shared_size;
+    char shared_name[64];
+    char socket_path[108];       // sun_path of the listening socket
+    int listener;
+    int client;                  // Connected client (-1 = none)
+} env_server;
+
+// Environment server API
+void create_env_server(env_server *server, vector_env *env, const char *socket_path);
+void run_env_server(env_server *server);
+void destroy_env_server(env_server *server, const char *socket_path);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include <stdint.h>
+#include "arcade.h"
+#include "video_frame.h"
+
+#define FRAME_EXPORT_PREFIX "/invaders-frames-"  // POSIX shared memory object (shm_open), followed by the emulator pid
+#define FRAME_EXPORT_MAGIC 0x58464E49            // "INFX"
+#define FRAME_EXPORT_VERSION 1
+#define SOUND_EVENT_SLOTS 1024                   // Sound latch changes kept in the ring (power of 2)
+
+// Frame flags: how the frontend presents the exported frame
+#define EXPORT_COLOR    0x01  // Cellophane color filter
+#define EXPORT_ROTATE   0x02  // Rotated by 90° counter-clockwise
+#define EXPORT_FLIP     0x04  // Mirrored vertically (semi-transparent mirror cabinet)
+#define EXPORT_COCKTAIL 0x08  // Flipped for player 2 on the cocktail table
+
+// The writer never waits for a reader. Each slot carries a sequence number (seqlock): 2 * n + 1 while frame
+// or event n is written, 2 * n + 2 when it is complete. A reader copies a slot and accepts the copy only if the
+// slot sequence was the same even value before and after the copy, otherwise the writer has lapped it.
+typedef struct {
+    uint64_t sequence;
+    uint64_t frame_count;          // Emulated video frame
+    uint64_t time_ns;              // CLOCK_MONOTONIC time of the publication
+    uint32_t flags;                // EXPORT_* bits
+    _Alignas(64) uint32_t pixels[GAME_WIDTH * GAME_HEIGHT];  // Game texture content, see convert_frame()
+} export_frame;
+
+typedef struct {
+    uint64_t sequence;
+    uint64_t cycles;               // CPU cycle of the OUT instruction
+    uint64_t frame_count;
+    uint8_t port;                  // 3 or 5
+    uint8_t data;                  // New sound latch value
+    uint8_t previous;              // Sound latch value before
+} sound_event;
+
+// Start of the shared memory, followed by the sound event ring and the frame ring (offsets from the start)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t frame_slots;
+    uint32_t sound_slots;
+    uint64_t frames;               // Published frames, frame n is in slot n % frame_slots
+    uint64_t sound_events;         // Published sound events, event n is in slot n % sound_slots
+    uint64_t frame_offset;
+    uint64_t sound_offset;
+} frame_export_header;
+
+// Frame export API (emulator side)
+void initialize_frame_export(arcade_system *system);
+void publish_frame(arcade_system *system, const uint32_t *pixels);
+void export_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data);
+void close_frame_export(void);
+const char *frame_export_name(void);
+
+// Reader API (capture processes)
+const frame_export_header *attach_frame_export(const char *name, size_t *size);
+int64_t read_export_frame(const frame_export_header *header, export_frame *frame);
+int read_sound_events(const frame_export_header *header, uint64_t *position, sound_event *events, int max_events);
+
+#endif
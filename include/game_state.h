@@ -0,0 +1,53 @@
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include <stdint.h>
+#include "arcade.h"
+
+#define INVADER_COUNT 55  // 5 rows of 11
+
+// Work RAM addresses of the game variables of a ROM set (Xr / Yr: the ROM's rotated screen coordinates)
+typedef struct {
+    char *name;
+    uint32_t rom_crc[4];         // ROM set identified by the CRC32 of its ROM files
+    uint16_t score[2];           // Player 1 and 2 score, 2 BCD bytes (LSB first)
+    uint16_t high_score;
+    uint16_t credits;            // BCD
+    uint16_t player_data;        // MSB of the data block of the current player (0x21 = player 1 at 0x2100, 0x22 = player 2)
+    uint16_t ships;              // Offset of the remaining ships in a player data block
+    uint16_t invaders;           // Offset of the invader table (1 byte per invader, != 0 = alive) in a player data block
+    uint16_t invader_count;
+    uint16_t game_mode;          // != 0 = game running (not the demo)
+    uint16_t player_alive;       // 0xFF = alive, else exploding
+    uint16_t player_x;           // Xr
+    uint16_t player_shot[3];     // Status, Yr and Xr
+    uint16_t invader_shot[3][3]; // Rolling, plunger and squiggly shot: status, Yr and Xr
+    uint16_t ufo_active;
+    uint16_t ufo_x;              // MSB of the pixel number (Xr)
+} game_ram_map;
+
+// Game variables of one frame, decoded from the work RAM
+typedef struct __attribute__((packed)) {
+    uint32_t score[2];           // Decimal
+    uint32_t high_score;
+    uint64_t invaders;           // Bit n = invader n of the current player alive (row by row from the bottom left)
+    uint8_t credits;
+    uint8_t player;              // Current player (1 or 2)
+    uint8_t ships;               // Remaining ships of the current player
+    uint8_t game_running;        // 0 = demo or attract mode
+    uint8_t invader_count;
+    uint8_t player_alive;
+    uint8_t player_x;
+    uint8_t player_shot[3];      // Status (0 = available), Yr and Xr
+    uint8_t invader_shot[3][3];
+    uint8_t ufo_active;
+    uint8_t ufo_x;
+} game_state;
+
+extern const game_ram_map invaders_ram_map;
+
+// Game state API
+const game_ram_map *find_game_ram_map(arcade_system *system);
+void read_game_state(const uint8_t *ram, const game_ram_map *map, game_state *game);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include "arcade.h"
+
+// A hot ROM loop executed natively. The native code runs whole loop iterations without computing the flags.
+// The last iteration is always left to the interpreter which produces the final flags.
+typedef struct hle_routine {
+    char *name;
+    uint16_t head;               // Loop head address in the ROM
+    uint8_t signature[32];       // Expected code bytes of the loop starting at the head
+    int length;                  // Number of signature bytes
+    int cycles;                  // CPU cycles of one loop iteration
+    int (*iterations)(Cpu_state *state);            // Remaining loop iterations at the loop head
+    void (*run)(Cpu_state *state, int iterations);  // Execute the given number of iterations natively
+} hle_routine;
+
+// ROM set identified by the CRC32 of its ROM files (as listed by MAME)
+typedef struct {
+    char *name;
+    uint32_t rom_crc[4];
+    const hle_routine *routines[MAX_HLE_ROUTINES];
+} hle_rom_set;
+
+// High level emulation API
+void match_hle_routines(arcade_system *system);
+void initialize_hle(arcade_system *system);
+void report_hle(arcade_system *system);
+
+#endif
@@ -3,6 +3,14 @@
 
 #include<stdint.h>
 #include<stdbool.h>
+#include "io_bus.h"
+
+// -- Memory map --
+#define ROM_SIZE  0x2000  // 0x0000 - 0x1FFF: ROM, shared by the instances of a ROM set
+#define RAM_START 0x2000  // 0x2000 - 0x3FFF: work and video RAM of each instance
+#define RAM_SIZE  0x2000
+#define RAM_PAGE_SIZE 0x100                     // Write tracking granularity (copy-on-write clones)
+#define RAM_PAGES (RAM_SIZE / RAM_PAGE_SIZE)    // One bit each in dirty_pages
 
 // -- Register names --
 enum Register {
@@ -28,13 +36,20 @@ typedef struct {
     //bool pad;
 } Condition_codes;
 
+// The registers share the first cache line, the RAM starts on its own cache line
 typedef struct {
     uint8_t regs[7];  // registers
     uint16_t sp;      // stack pointer
     uint16_t pc;      //program counter
-    uint8_t memory[0x4000]; // The system has 8K of ROM and 8K of RAM
     Condition_codes cc;
     uint8_t int_enable;
+    uint8_t halted;   // HLT executed, waiting for an interrupt
+    uint16_t rom_end; // Writes below this address are ignored (ROM)
+    uint32_t dirty_pages;  // RAM pages written since the last clone or restore (bit n = RAM_PAGE_SIZE bytes at RAM page n)
+    uint8_t *rom;     // 0x0000 - 0x1FFF, not written by the CPU below rom_end (shared ROM pages)
+    const io_bus *bus;  // IN and OUT instructions are dispatched to the port handlers of the bus (shared by the instances)
+    void *device;     // Context passed to the port handlers (e.g. the arcade system)
+    _Alignas(64) uint8_t ram[RAM_SIZE];  // 0x2000 - 0x3FFF, owned by each instance
 } Cpu_state;
 
 // CPU API
@@ -4,9 +4,12 @@
 #include <stdint.h>
 #include "arcade.h"
 
-// i8080 Port API
-void set_arcade_system(arcade_system *system);
-uint8_t read_port(uint8_t port_number);
-void write_port(uint8_t port_number, uint8_t port_data);
+extern const io_bus si_board_bus;
+
+// i8080 Port API (Space Invaders board devices on the I/O bus)
+void attach_si_board(arcade_system *system);
+void initialize_input_ports(arcade_system *system);
+void set_input_word(arcade_system *system, uint8_t input);
+void update_input_ports(arcade_system *system, uint8_t bits, int state);
 
 #endif
\ No newline at end of file
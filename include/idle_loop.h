@@ -0,0 +1,31 @@
+#ifndef IDLE_LOOP_H
+#define IDLE_LOOP_H
+
+#include <stdint.h>
+#include "i8080.h"
+
+#define IDLE_LOOP_CACHE 64     // Direct mapped cache of analyzed loops in ROM
+#define IDLE_LOOP_MAX_BYTES 32 // Longer loops are not analyzed
+
+enum Idle_loop_status {
+    LOOP_UNKNOWN,
+    LOOP_PURE,                 // Loop body only reads memory and changes registers and flags
+    LOOP_NOT_PURE,
+};
+
+typedef struct {
+    uint16_t head;             // Jump target (loop start)
+    uint16_t jump;             // Address of the backward jump
+    uint8_t status;
+} idle_loop;
+
+typedef struct {
+    idle_loop cache[IDLE_LOOP_CACHE];
+    uint64_t skipped_cycles;   // Statistics: cycles credited without executing them
+} idle_loops;
+
+// Idle loop detection API
+void initialize_idle_loops(idle_loops *idle);
+uint64_t skip_idle_loop(idle_loops *idle, Cpu_state *state, uint16_t jump, uint64_t cycles, uint64_t deadline);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef INSTANCE_POOL_H
+#define INSTANCE_POOL_H
+
+#include <stddef.h>
+#include "arcade.h"
+
+#define HUGE_PAGE_SIZE 0x200000  // 2M pages backing the arena
+
+enum Pool_pages {
+    POOL_SMALL_PAGES,            // Normal pages
+    POOL_HUGE_PAGES,             // Reserved huge pages (MAP_HUGETLB), else transparent huge pages
+    POOL_TRANSPARENT_PAGES,      // Transparent huge pages (madvise), the kernel may still use normal pages
+};
+
+// Fixed number of machine slots in one arena, created, reset and destroyed in O(1) by copying a started template.
+// Not thread safe: use one pool per thread or lock around acquire and release.
+typedef struct {
+    uint8_t *arena;              // capacity slots of sizeof(arcade_system) (cache line aligned)
+    size_t arena_size;
+    int capacity;
+    int *free_slots;             // Stack of the free slot numbers
+    int free_count;
+    const arcade_system *template;
+    int pages;                   // Pool_pages actually backing the arena
+} instance_pool;
+
+// Instance pool API
+void create_instance_pool(instance_pool *pool, const arcade_system *template, int capacity, int pages);
+arcade_system *acquire_instance(instance_pool *pool);
+void reset_pool_instance(instance_pool *pool, arcade_system *system);
+void release_instance(instance_pool *pool, arcade_system *system);
+arcade_system *pool_instance(instance_pool *pool, int slot);
+void destroy_instance_pool(instance_pool *pool);
+
+#endif
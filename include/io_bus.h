@@ -0,0 +1,24 @@
+#ifndef IO_BUS_H
+#define IO_BUS_H
+
+#include <stdint.h>
+
+// Port handlers get the device context of the CPU (Cpu_state.device, e.g. the arcade system)
+typedef uint8_t (*port_read_handler)(void *device, uint8_t port_number);
+typedef void (*port_write_handler)(void *device, uint8_t port_number, uint8_t port_data);
+
+// One read and one write handler per 8080 port number. The handler table of a board is the same for all its
+// instances, so it is shared (e.g. the const si_board_bus) and only the device context is per instance.
+typedef struct {
+    port_read_handler read[256];
+    port_write_handler write[256];
+} io_bus;
+
+// I/O Bus API
+uint8_t unmapped_read(void *device, uint8_t port_number);
+void unmapped_write(void *device, uint8_t port_number, uint8_t port_data);
+void initialize_io_bus(io_bus *bus);
+void map_read_port(io_bus *bus, uint8_t port_number, port_read_handler handler);
+void map_write_port(io_bus *bus, uint8_t port_number, port_write_handler handler);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS 51       // 1ms buckets from 0 to 50ms, the last bucket holds everything above
+#define LATENCY_BUCKET_USEC 1000
+
+typedef struct {
+    char *name;
+    uint32_t count[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t min;                // µs
+    uint32_t max;                // µs
+    uint64_t sum;                // µs
+} latency_histogram;
+
+// Latency histogram API
+void initialize_latency_histogram(latency_histogram *histogram, char *name);
+void record_latency(latency_histogram *histogram, uint32_t usec);
+void print_latency_histogram(latency_histogram *histogram);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include "arcade.h"
+
+#define PROBE_INPUTS (INPUT_LEFT | INPUT_RIGHT | INPUT_SHOT)  // Inputs with a visible reaction near the laser base
+#define PROBE_TIMEOUT_FRAMES 30                               // Give up if the laser base area does not change
+
+// Input-to-photon latency probe API
+void initialize_latency_probe(void);
+void probe_input_event(arcade_system *system, uint8_t bit, uint32_t timestamp);
+void probe_port_read(arcade_system *system, uint8_t bits);
+void probe_frame_end(arcade_system *system);
+void probe_frame_presented(void);
+void report_latency_probe(void);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define UPRIGHT_WIDTH  224  // Screen as seen in the cabinet (the monitor is rotated)
+#define UPRIGHT_HEIGHT 256
+
+enum Observation_pooling {
+    OBSERVATION_MAX,             // 255 if any pixel of the box is set (thin shots survive the downsampling)
+    OBSERVATION_MEAN,            // Share of the set pixels of the box as gray level 0 - 255
+};
+
+// Crop rectangle of the upright screen scaled down to the observation size
+typedef struct {
+    int x, y;                    // Upper left corner of the crop rectangle
+    int width, height;
+    int out_width, out_height;   // Observation size (<= crop size), e.g. 84 x 84
+    int pooling;
+} observation_spec;
+
+// Ring of the last frames, stored twice so the last depth frames are always contiguous (oldest first)
+typedef struct {
+    int depth;
+    size_t frame_size;
+    int head;                    // Slot of the next frame
+    uint8_t *buffer;             // 2 * depth frames
+} frame_stack;
+
+// Observation API
+void downsample_frame(const uint8_t *ram, const observation_spec *spec, uint8_t *out);
+void create_frame_stack(frame_stack *stack, int depth, size_t frame_size);
+void reset_frame_stack(frame_stack *stack, const uint8_t *frame);
+void push_frame(frame_stack *stack, const uint8_t *frame);
+void push_observation(frame_stack *stack, const uint8_t *ram, const observation_spec *spec);
+const uint8_t *stacked_frames(const frame_stack *stack);
+void destroy_frame_stack(frame_stack *stack);
+
+#endif
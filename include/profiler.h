@@ -0,0 +1,37 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "i8080.h"
+
+// Guest code profiler, only compiled into the CPU core with -DPROFILE (make profile)
+
+#define PROFILE_SYMBOL_FILE "invaders.sym"         // Optional ROM symbols: one "<hex address> <name>" per line
+#define PROFILE_SYMBOL_VARIABLE "INVADERS_SYMBOLS" // Environment variable naming another symbol file
+#define PROFILE_TOP_ENTRIES 40                     // Lines per report section
+#define MAX_PROFILE_SYMBOLS 1024
+#define MAX_PROFILE_EDGES 4096                     // Call graph edges, additional ones are counted as dropped
+#define PROFILE_STACK_DEPTH 64                     // Shadow call stack for the inclusive routine cycles
+
+typedef enum {
+    EDGE_CALL,
+    EDGE_RST,
+    EDGE_INT,
+    EDGE_RET,
+} profile_edge_kind;
+
+typedef struct {
+    uint16_t from;
+    uint16_t to;
+    uint8_t kind;
+    uint8_t used;
+    uint64_t count;
+} profile_edge;
+
+// Profiler API
+void initialize_profiler(void);
+void profile_opcode(Cpu_state *state, uint16_t pc, uint16_t sp, uint8_t op_code, int cycles);
+void profile_interrupt(Cpu_state *state, uint16_t pc, int cycles);
+void report_profile(void);
+
+#endif
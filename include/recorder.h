@@ -0,0 +1,30 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include "arcade.h"
+
+#define RECORD_QUEUE_SIZE (4 << 20)  // Bytes of compressed frames between the emulation and the writer thread
+#define RECORD_SAMPLE_RATE 48000     // Same as the SDL mixer
+#define RECORD_VOICES 8              // Samples played at the same time (SDL mixer channels)
+
+enum Record_format {
+    RECORD_OFF,
+    RECORD_Y4M,                  // One YUV4MPEG2 file (4:2:0, gray)
+    RECORD_PNG,                  // One 1 bit per pixel PNG file per frame
+};
+
+// Queue entry, followed by the frame compressed against the previous entry (see compress_frame)
+typedef struct {
+    uint32_t size;               // Compressed bytes (0 = skip to the start of the queue)
+    uint16_t sounds;             // Bit n: sample n triggered during the frame
+    uint64_t frame_count;        // Emulated video frame
+} record_entry;
+
+// Recorder API
+void initialize_recorder(arcade_system *system, const char *name);
+void record_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data);
+void record_frame(arcade_system *system);
+void close_recorder(void);
+
+#endif
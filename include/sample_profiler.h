@@ -0,0 +1,41 @@
+#ifndef SAMPLE_PROFILER_H
+#define SAMPLE_PROFILER_H
+
+#include <stdint.h>
+#include "arcade.h"
+
+#define SAMPLE_FILE "invaders.samples"   // Binary samples, see sample_record
+#define FOLDED_FILE "invaders.folded"    // Folded stacks for flame graph tools, written at exit
+#define SAMPLE_STACK_DEPTH 16            // Host stack frames kept per sample
+#define SAMPLE_RING_SIZE 1024            // Samples buffered between two flushes (one per video frame)
+#define MAX_FOLDED_STACKS 16384
+#define MAX_HOST_SYMBOLS 4096
+
+// What the emulator is doing, set by the execution loop
+typedef enum {
+    PHASE_OTHER,
+    PHASE_INPUT,
+    PHASE_CPU,
+    PHASE_DRAW,
+    PHASE_PRESENT,
+    PHASE_SLEEP,
+} emulator_phase;
+
+// Sample file: "I8SP", uint32 version, uint32 interval (µs), uint32 stack depth, followed by the samples.
+// A sample is stored with the used host stack frames only (depth entries).
+typedef struct {
+    uint32_t frame;                       // Video frame counter
+    uint16_t pc;                          // Guest PC
+    uint8_t phase;                        // emulator_phase
+    uint8_t depth;                        // Number of host stack frames (innermost first)
+    uint64_t host[SAMPLE_STACK_DEPTH];
+} sample_record;
+
+// Sampling profiler API
+void initialize_sample_profiler(arcade_system *system);
+void start_sample_profiler(void);
+void set_emulator_phase(emulator_phase phase);
+void flush_samples(void);
+void report_sample_profiler(void);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include "i8080.h"
+#include "idle_loop.h"
+
+#define MAX_TIMED_EVENTS 8
+
+// Event handlers get the device pointer given when the event has been scheduled
+typedef void (*event_handler)(void *device);
+
+// Entry hooks may execute code natively and return the new master cycle counter value (<= deadline)
+typedef uint64_t (*entry_hook)(void *device, Cpu_state *state, uint64_t cycles, uint64_t deadline);
+
+typedef struct {
+    uint64_t deadline;           // Master cycle counter value when the event is due
+    event_handler handler;
+    void *device;
+} timed_event;
+
+typedef struct {
+    uint64_t cycles;             // Master cycle counter (CPU cycles since power up)
+    idle_loops *idle;            // Idle loop fast-forward (NULL = off)
+    const uint8_t *hook_entry;   // One byte per ROM address (0x0000 - 0x1FFF), != 0 calls the hook (NULL = off)
+    entry_hook hook;
+    void *hook_device;
+    int count;                   // Number of pending events
+    timed_event events[MAX_TIMED_EVENTS];  // Pending events sorted by deadline
+} scheduler;
+
+// Scheduler API
+void initialize_scheduler(scheduler *sched);
+void schedule_event(scheduler *sched, uint64_t deadline, event_handler handler, void *device);
+void run_next_event(scheduler *sched, Cpu_state *state);
+
+#endif
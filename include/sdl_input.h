@@ -5,6 +5,9 @@
 #include "arcade.h"
 
 // Input API
+void initialize_input(arcade_system *system);
 void handleInput(arcade_system *system);
+void input_port_read(arcade_system *system, uint8_t port_number);
+void report_input_latency(arcade_system *system);
 
 #endif
\ No newline at end of file
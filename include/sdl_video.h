@@ -2,9 +2,8 @@
 #define DISPLAY_H
 
 #include "arcade.h"
+#include "video_frame.h"
 
-#define GAME_WIDTH  256
-#define GAME_HEIGHT 224
 #define STRETCH_4_3 1.16375  // 4:3 = 1.33 = 1.16375 * 256 / 224
 
 #define CELLOPHANE_GREEN 0x8000FF00  // ABGR
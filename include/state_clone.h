@@ -0,0 +1,58 @@
+#ifndef STATE_CLONE_H
+#define STATE_CLONE_H
+
+#include <stdint.h>
+#include "arcade.h"
+
+#define CLONE_CHUNK 256  // Pages or clones allocated at once
+
+// RAM page shared copy-on-write by clones and instances
+typedef struct ram_page {
+    uint64_t id;                 // Content id (0 = free page)
+    uint32_t references;         // Clones holding the page
+    struct ram_page *next_free;
+    _Alignas(64) uint8_t data[RAM_PAGE_SIZE];
+} ram_page;
+
+// Branch point of a machine (e.g. a search tree node): registers, devices and shared RAM pages
+typedef struct state_clone {
+    uint8_t regs[7];
+    uint16_t sp;
+    uint16_t pc;
+    Condition_codes cc;
+    uint8_t int_enable;
+    uint8_t halted;
+    uint16_t ext_shift_data;
+    uint8_t ext_shift_offset;
+    uint8_t sound_latch[2];
+    uint8_t cocktail_vertical_screen_flip;
+    uint8_t input;
+    uint8_t input_port[3];
+    uint8_t input_pending;
+    uint64_t frame_count;
+    const arcade_system *origin; // Instance the scheduler has been taken from
+    scheduler scheduler;
+    ram_page *pages[RAM_PAGES];
+    struct state_clone *next_free;
+} state_clone;
+
+// Pages and clones of the instances of one ROM set. Not thread safe: use one store per thread.
+typedef struct clone_store {
+    uint64_t serial;             // Unique per store in the process
+    ram_page *free_pages;
+    state_clone *free_clones;
+    void **chunks;               // Allocated page and clone blocks
+    int chunk_count;
+    uint64_t next_id;
+    uint64_t pages_shared;       // Statistics: pages taken over by clone_instance() without copying
+    uint64_t pages_copied;       // Statistics: pages copied by clone_instance() and restore_clone()
+} clone_store;
+
+// Copy-on-write clone API
+void create_clone_store(clone_store *store);
+state_clone *clone_instance(clone_store *store, arcade_system *system);
+void restore_clone(clone_store *store, arcade_system *system, const state_clone *clone);
+void release_clone(clone_store *store, state_clone *clone);
+void destroy_clone_store(clone_store *store);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "arcade.h"
+
+#define WORK_RAM 0x2000
+#define WORK_RAM_SIZE 0x0400    // Work RAM and stack up to the video RAM
+#define VIDEO_RAM_SIZE 0x1C00
+
+typedef struct {
+    uint64_t video;             // 0x2400 - 0x3FFF
+    uint64_t work;              // 0x2000 - 0x23FF
+} frame_hash;
+
+// State hash API
+uint64_t hash_memory(const uint8_t *data, size_t size);
+void hash_frame(arcade_system *system, frame_hash *hash);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_POOL_THREADS 256
+
+// Task executed once per index of a batch
+typedef void (*pool_task)(void *context, int index);
+
+// Indices of a batch owned by one thread. Other threads steal from it once their own range is done.
+typedef struct {
+    _Alignas(64) atomic_int next;  // Next index to run (own cache line, the owner and the thieves take indices here)
+    int end;
+} pool_range;
+
+// Start argument of a worker thread
+typedef struct {
+    struct thread_pool *pool;
+    int id;                      // Index of the own range
+} pool_worker;
+
+typedef struct thread_pool {
+    pthread_t threads[MAX_POOL_THREADS];
+    int thread_count;            // Including the calling thread which takes part in each batch
+    pthread_mutex_t lock;
+    pthread_cond_t start;        // A new batch is available
+    pthread_cond_t done;         // All workers finished the batch
+    unsigned int generation;     // Batch number
+    int busy;                    // Workers still running the current batch
+    int quit;
+    pool_task task;
+    void *context;
+    pool_range ranges[MAX_POOL_THREADS];
+    pool_worker workers[MAX_POOL_THREADS];
+} thread_pool;
+
+// Work-stealing thread pool API
+void create_thread_pool(thread_pool *pool, int thread_count);
+void run_thread_pool(thread_pool *pool, int count, pool_task task, void *context);
+void destroy_thread_pool(thread_pool *pool);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef VECTOR_ENV_H
+#define VECTOR_ENV_H
+
+#include <stdint.h>
+#include "arcade.h"
+#include "thread_pool.h"
+#include "instance_pool.h"
+#include "game_state.h"
+#include "observation.h"
+
+#define OBSERVATION_SIZE 0x1C00  // 1 bit per pixel video RAM (0x2400 - 0x3FFF) of one instance
+
+// Batch of headless instances of one ROM set stepped together, e.g. for reinforcement learning
+typedef struct {
+    int count;                   // Number of instances
+    arcade_system *template;     // ROM set loaded and started once, copied to reset an instance
+    arcade_system *instances;    // The first count slots of the instance pool
+    instance_pool slots;
+    const uint8_t *inputs;       // Input words (INPUT_* bits) of the running step, one per instance
+    uint8_t *observations;       // count * OBSERVATION_SIZE bytes, the video RAM of each instance after the last step
+    game_state *game_states;     // Game variables of each instance after the last step (with a RAM map)
+    const game_ram_map *ram_map; // RAM map of the ROM set (NULL = unknown, may be set after the creation)
+    observation_spec spec;       // Downsampling of the preprocessed observations
+    frame_stack *frame_stacks;   // Last preprocessed observations of each instance (NULL = off)
+    int external_buffers;        // Observations and game states provided by the caller (e.g. shared memory)
+    thread_pool pool;
+} vector_env;
+
+// Vector environment API
+vector_env *create_vector_env(char *filename, int count, int thread_count);
+void reset_vector_env(vector_env *env, int index);
+void step_vector_env(vector_env *env, const uint8_t *inputs);
+void enable_vector_preprocessing(vector_env *env, const observation_spec *spec, int depth);
+void attach_vector_buffers(vector_env *env, uint8_t *observations, game_state *game_states);
+void destroy_vector_env(vector_env *env);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef VIDEO_FRAME_H
+#define VIDEO_FRAME_H
+
+#include <stdint.h>
+#include "i8080.h"
+
+#define GAME_WIDTH  256
+#define GAME_HEIGHT 224
+#define VIDEO_RAM   0x2400  // 1 bit per pixel, 32 bytes per CRT line
+
+// Video frame conversion API (no SDL dependencies)
+void convert_frame(const uint8_t *ram, uint32_t *pixels);
+
+#endif
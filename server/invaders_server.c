@@ -0,0 +1,47 @@
+// ****************************************************************************************
+// * Environment server
+// * Hosts a batch of headless instances of one ROM set and serves them to other processes
+// * over a UNIX domain socket (include/env_server.h). The observations and game states
+// * of all instances are left in POSIX shared memory, only the commands, the inputs and
+// * the status go over the socket.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "env_server.h"
+
+#define DEFAULT_INSTANCES 64
+#define MAX_INSTANCES 65536
+
+/**
+ * Usage: invaders-server [-n instances] [-j threads] [-s socket] <ini file>
+*/
+int main(int argc, char *argv[]) {
+    int instances = DEFAULT_INSTANCES, threads = sysconf(_SC_NPROCESSORS_ONLN), option = 0;
+    const char *socket_path = DEFAULT_SERVER_SOCKET;
+    vector_env *env = NULL;
+    env_server server;
+
+    while ((option = getopt(argc, argv, "n:j:s:")) != -1) {
+        switch (option) {
+        case 'n': instances = atoi(optarg);     break;
+        case 'j': threads = atoi(optarg);       break;
+        case 's': socket_path = optarg;         break;
+        default: optind = argc + 1;             break;
+        }
+    }
+    if (optind != argc - 1 || instances < 1 || instances > MAX_INSTANCES) {
+        printf("Usage: invaders-server [-n instances] [-j threads] [-s socket] <ini file>\n");
+        return 1;
+    }
+
+    env = create_vector_env(argv[optind], instances, threads < 1 ? 1 : threads);
+    create_env_server(&server, env, socket_path);
+    printf("Serving %d instances on %s, shared memory %s (%zu bytes)\n", instances, socket_path, server.shared_name, server.shared_size);
+    fflush(stdout);
+    run_env_server(&server);
+    destroy_env_server(&server, socket_path);
+    destroy_vector_env(env);
+    return 0;
+}
@@ -2,52 +2,55 @@
 #include <string.h>
 #include <sys/time.h>
 #include "arcade.h"
-#include "i8080_ports.h"
 #include "config_rom_loader.h"
 #include "sdl_video.h"
 #include "sdl_sound.h"
 #include "sdl_input.h"
+#include "latency_probe.h"
+#include "hle.h"
+#include "sample_profiler.h"
+#include "frame_export.h"
+#include "recorder.h"
+#ifdef PROFILE
+#include "profiler.h"
+#endif
 
-#define FRAMERATE 59.541985                         // ~60Hz Video refreshrate
-#define CYCLES_PER_FRAME 1996800 / FRAMERATE        // ~2MHz 8080 CPU clock frequency
-#define MICROSEC_PER_FRAME 1000000 / FRAMERATE      // 1µs emulation resolution
+/**
+ * Sound latch changes go to the frame export and the recorder
+*/
+void frontend_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data) {
+    if (system->frame_export) {
+        export_sound_event(system, port_number, port_data);
+    }
+    if (system->record) {
+        record_sound_event(system, port_number, port_data);
+    }
+}
 
 /**
  * Create the Invaders Arcade System
 */
 void initialize_arcade_system(arcade_system *system) {
-    // Initialize the CPU state
-    system->state.pc = 0;
-    system->state.sp = 0;
-    system->state.int_enable = 0;
-    system->state.cc.ac = 0;
-    system->state.cc.cy = 0;
-    system->state.cc.z = 0;
-    system->state.cc.s = 0;
-    system->state.cc.p = 0;
-    for (int i = 0; i < 7; i++) {
-        system->state.regs[i] = 0;
+    initialize_arcade_machine(system);  // CPU, board and optional features reset
+    initialize_input(system);           // Input latency measurement
+
+    load_config_rom(system);             // Load the invaders.ini and the listed invader ROMs
+    initialize_sample_profiler(system);  // Before any SDL thread is started
+    initialize_audio(system);            // Initialize the SDL Mixer
+    initialize_video(system);            // Initialize the SDL video output
+    initialize_frame_export(system);     // Optional shared memory frame and sound event export
+    initialize_recorder(system, NULL);   // Optional recording with a background writer thread
+
+    // Connect the SDL frontend to the machine
+    system->play_sound = play_sound;
+    system->input_port_read = input_port_read;
+    system->poll_input = handleInput;
+    if (system->frame_export || system->record) {
+        system->sound_event = frontend_sound_event;
     }
 
-    // Set inputs to 0
-    system->left = 0;
-    system->right = 0;
-    system->shot = 0;
-    system->start1 = 0;
-    system->start2 = 0;
-    system->coin = 0;
-    system->tilt = 0;
-    system->quit = 0;
-
-    system->ext_shift_offset = 0;  // The external shift register shift amount
-    system->ext_shift_data = 0;    // The external shift register data
-
-    system->cocktail_vertical_screen_flip = 0;  // Flip the screen vertically for a 2P SI cocktail table game
-
-    load_config_rom(system);       // Load the invaders.ini and the listed invader ROMs
-    initialize_audio(system);      // Initialize the SDL Mixer
-    initialize_video(system);      // Initialize the SDL video output
-    set_arcade_system(system);     // Provide the arcade system pointer to the port handling
+    start_arcade_machine(system);
+    start_sample_profiler();
 }
 
 /**
@@ -64,35 +67,41 @@ long long timeInMicroseconds(void) {
  * Arcade execution loop
 */
 void run_arcade_system(arcade_system *system) {
-    int cyc = 0, int_state = 0;
     uint64_t timer = 0, delta = 0;
+    int run_ahead = system->run_ahead;  // Frames emulated ahead of the presented frame
+    arcade_snapshot snapshot;
+
+    save_arcade_state(system, &snapshot);
 
     timer = timeInMicroseconds();
     while (!system->quit) {
-        int_state = 0;
-
+        set_emulator_phase(PHASE_INPUT);
         handleInput(system);  // Input is read every 1/FRAMERATE
 
-        while(int_state != 2) {
-            // Let's execute as many CPU cycles as one video frame takes to be drawn
-            // We always assume that the emulation speed for a single frame is faster than 1/FRAMERATE
-            cyc += exec_opcode(&system->state); // Execute the next opcode
+        // We always assume that the emulation speed for a single frame is faster than 1/FRAMERATE
+        set_emulator_phase(PHASE_CPU);
+        emulate_frame(system);
+        if (system->record) {
+            record_frame(system);  // Queued for the writer thread, never waits for the disk
+        }
 
-            if (cyc >= CYCLES_PER_FRAME / 2 && int_state == 0) {
-                // 1st half of the video frame has been drawn => 1st interrupt vector RST 8
-                int_state = 1;
-                cyc += interrupt(&system->state, 1);
+        if (run_ahead) {
+            // Run-ahead: emulate the next frames with the current inputs and present the last one.
+            // The game reacts to an input one or more frames after reading the ports, this hides that lag.
+            save_arcade_state(system, &snapshot);
+            system->sound_mute = 1;  // The sound of the frames ahead is played when they are emulated for real
+            for (int i = 0; i < run_ahead; i++) {
+                emulate_frame(system);
             }
+            system->sound_mute = 0;
+        }
 
-            if (cyc >= CYCLES_PER_FRAME && int_state == 1) {
-                // 2nd half of the video frame has been drawn => 2nd interrupt vector RST 10
-                int_state = 2;
-                cyc += interrupt(&system->state, 2);
-            }
+        if (system->input_mode[2]) {
+            probe_frame_end(system);  // Input-to-photon latency: look for the laser base reacting in the video RAM
         }
-        cyc = CYCLES_PER_FRAME - cyc;  // The emulation already used cycles beyond CYCLES_PER_FRAME caused by the 2nd interrupt
 
         // Now we must synchronize with the video timing by waiting until 1/FRAMERATE passed
+        set_emulator_phase(PHASE_SLEEP);
         delta = timeInMicroseconds() - timer;
         if (delta > MICROSEC_PER_FRAME) {
             printf("Emulation for one frame was too slow:  %6.3f ms / Frame \n", delta/1000.0);
@@ -104,7 +113,31 @@ void run_arcade_system(arcade_system *system) {
         }
         timer = timeInMicroseconds();
 
+        set_emulator_phase(PHASE_DRAW);
         draw_frame(system);  // Drawing the video frame in the emulation is much faster than on the original CRT
+
+        if (system->input_mode[2]) {
+            probe_frame_presented();  // Input-to-photon latency: SDL_RenderPresent() returned
+        }
+
+        if (run_ahead) {
+            load_arcade_state(system, &snapshot);  // Continue with the real frame
+        }
+
+        set_emulator_phase(PHASE_OTHER);
+        flush_samples();  // Sampling profiler: write the samples of this frame
+    }
+    report_input_latency(system);
+    if (system->idle_skip) {
+        printf("Idle loop fast-forward: %5.1f%% of the CPU cycles skipped\n",
+               100.0 * system->idle_loops.skipped_cycles / system->scheduler.cycles);
     }
+    report_hle(system);
+    report_sample_profiler();
+    close_frame_export();
+    close_recorder();
+#ifdef PROFILE
+    report_profile();
+#endif
     clear_audio();
 }
\ No newline at end of file
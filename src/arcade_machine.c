@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "arcade.h"
+#include "i8080_ports.h"
+#include "hle.h"
+#ifdef PROFILE
+#include "profiler.h"
+#endif
+
+/**
+ * Master cycle counter value of a position (0.0 - 1.0) within the given video frame.
+ * An event is due with the first instruction boundary reaching that position.
+*/
+uint64_t frame_deadline(uint64_t frame, double position) {
+    double exact = (frame + position) * CYCLES_PER_FRAME;
+    uint64_t deadline = (uint64_t)exact;
+
+    if (deadline < exact) {
+        deadline++;
+    }
+    return deadline;
+}
+
+/**
+ * 1st half of the video frame has been drawn => 1st interrupt vector RST 8
+*/
+void mid_screen_event(void *device) {
+    arcade_system *system = device;
+
+    system->scheduler.cycles += interrupt(&system->state, 1);
+    schedule_event(&system->scheduler, frame_deadline(system->frame_count + 1, 0.5), mid_screen_event, system);
+}
+
+/**
+ * 2nd half of the video frame has been drawn => 2nd interrupt vector RST 10
+*/
+void vblank_event(void *device) {
+    arcade_system *system = device;
+
+    system->scheduler.cycles += interrupt(&system->state, 2);
+    schedule_event(&system->scheduler, frame_deadline(system->frame_count + 1, 1.0), vblank_event, system);
+    system->frame_count++;
+    system->frame_done = 1;
+}
+
+/**
+ * Mid-frame input polling halves the average wait until the game can see an input change
+*/
+void input_event(void *device) {
+    arcade_system *system = device;
+
+    if (system->poll_input) {
+        system->poll_input(system);
+    }
+    schedule_event(&system->scheduler, frame_deadline(system->frame_count + 1, 0.5), input_event, system);
+}
+
+/**
+ * Size of the ROM bank rounded up to whole pages
+*/
+size_t rom_bank_size(void) {
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    return (sizeof(rom_bank) + page - 1) / page * page;
+}
+
+/**
+ * Build the tables derived from the ROM content and write protect the ROM bank.
+ * Done once for all copies of the machine, the first start seals the bank.
+*/
+void seal_rom_bank(arcade_system *system) {
+    if (system->rom_bank->sealed) {
+        return;
+    }
+    match_hle_routines(system);
+    system->rom_bank->sealed = 1;
+    mprotect(system->rom_bank, rom_bank_size(), PROT_READ);
+}
+
+/**
+ * Reset the arcade machine (CPU, board devices and optional features) before the configuration is loaded.
+ * A new ROM bank is allocated. No frontend is connected: no sound output, no input polling.
+*/
+void initialize_arcade_machine(arcade_system *system) {
+    // Initialize the CPU state
+    system->state.pc = 0;
+    system->state.sp = 0;
+    system->state.int_enable = 0;
+    system->state.halted = 0;
+    system->state.rom_end = ROM_SIZE;  // 8K ROM followed by the RAM
+    system->rom_bank = mmap(NULL, rom_bank_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (system->rom_bank == MAP_FAILED) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    system->state.rom = system->rom_bank->rom;
+    memset(system->state.ram, 0, sizeof(system->state.ram));
+    system->state.dirty_pages = ~0u;
+    system->clone_source.store = 0;
+    system->state.cc.ac = 0;
+    system->state.cc.cy = 0;
+    system->state.cc.z = 0;
+    system->state.cc.s = 0;
+    system->state.cc.p = 0;
+    for (int i = 0; i < 7; i++) {
+        system->state.regs[i] = 0;
+    }
+
+    // Set inputs to 0
+    system->input = 0;
+    system->input_pending = 0;
+    for (int i = 0; i < 8; i++) {
+        system->input_stamp[i] = 0;
+    }
+    system->quit = 0;
+
+    system->ext_shift_offset = 0;  // The external shift register shift amount
+    system->ext_shift_data = 0;    // The external shift register data
+
+    system->cocktail_vertical_screen_flip = 0;  // Flip the screen vertically for a 2P SI cocktail table game
+    system->sound_latch[0] = 0;    // Port 3 & 5 sound bits of the last OUT instruction
+    system->sound_latch[1] = 0;
+    system->sound_mute = 0;
+    system->frame_count = 0;
+    system->frame_done = 0;
+
+    // Optional invaders.ini lines are switched off if not configured
+    memset(system->input_mode, 0, sizeof(system->input_mode));
+    system->run_ahead = 0;
+    system->idle_skip = 0;
+    system->hle_mode = 0;
+    system->sample_profile = 0;
+    system->frame_export = 0;
+    system->record = 0;
+    system->rom_count = 0;
+
+    system->play_sound = NULL;
+    system->input_port_read = NULL;
+    system->poll_input = NULL;
+    system->sound_event = NULL;
+}
+
+/**
+ * Connect the board devices and start the video timing once the configuration and the ROMs are loaded
+*/
+void start_arcade_machine(arcade_system *system) {
+    seal_rom_bank(system);           // The ROM content is complete
+    initialize_input_ports(system);  // Fold the DIP switches into the input ports
+    attach_si_board(system);         // Connect the shift register, input, sound and watchdog ports to the CPU
+
+    // The video timing drives the CPU interrupts
+    initialize_scheduler(&system->scheduler);
+    if (system->idle_skip) {
+        initialize_idle_loops(&system->idle_loops);
+        system->scheduler.idle = &system->idle_loops;
+    }
+    initialize_hle(system);  // Native execution of hot ROM routines
+#ifdef PROFILE
+    initialize_profiler();   // Guest code hot spots, profiling build only
+#endif
+    schedule_event(&system->scheduler, frame_deadline(0, 0.5), mid_screen_event, system);
+    schedule_event(&system->scheduler, frame_deadline(0, 1.0), vblank_event, system);
+    if (system->input_mode[0]) {
+        schedule_event(&system->scheduler, frame_deadline(0, 0.5), input_event, system);
+    }
+}
+
+/**
+ * Copy a started arcade machine into another instance (e.g. to reset it from a template).
+ * The pointers into the source instance (port device context, timed events, idle loops and HLE hook) are redirected,
+ * the ROM bank is shared.
+*/
+void copy_arcade_machine(arcade_system *to, const arcade_system *from) {
+    *to = *from;
+    if (from->state.device == from) {
+        to->state.device = to;
+    }
+    adopt_scheduler(to, &from->scheduler, from);
+}
+
+/**
+ * Take over the scheduler state of another instance (from): its timed events, idle loops and HLE hook are
+ * redirected to this instance. The other instance is not accessed, it may no longer exist.
+*/
+void adopt_scheduler(arcade_system *system, const scheduler *sched, const arcade_system *from) {
+    system->scheduler = *sched;
+    for (int i = 0; i < sched->count; i++) {
+        if (sched->events[i].device == from) {
+            system->scheduler.events[i].device = system;
+        }
+    }
+    if (sched->idle) {
+        system->scheduler.idle = &system->idle_loops;
+    }
+    if (sched->hook_entry) {
+        system->scheduler.hook_device = system;
+    }
+}
+
+/**
+ * Free the ROM bank of a machine set up by initialize_arcade_machine(). Its copies must not be used afterwards.
+*/
+void release_arcade_machine(arcade_system *system) {
+    munmap(system->rom_bank, rom_bank_size());
+    system->rom_bank = NULL;
+    system->state.rom = NULL;
+}
+
+/**
+ * Take a snapshot of the emulated machine state (CPU, RAM, shift register and port latches)
+*/
+void save_arcade_state(arcade_system *system, arcade_snapshot *snapshot) {
+    snapshot->state = system->state;
+    snapshot->ext_shift_data = system->ext_shift_data;
+    snapshot->ext_shift_offset = system->ext_shift_offset;
+    snapshot->sound_latch[0] = system->sound_latch[0];
+    snapshot->sound_latch[1] = system->sound_latch[1];
+    snapshot->cocktail_vertical_screen_flip = system->cocktail_vertical_screen_flip;
+    snapshot->scheduler = system->scheduler;
+    snapshot->idle_skipped_cycles = system->idle_loops.skipped_cycles;
+    snapshot->frame_count = system->frame_count;
+}
+
+/**
+ * Restore the emulated machine state from a snapshot
+*/
+void load_arcade_state(arcade_system *system, arcade_snapshot *snapshot) {
+    system->state = snapshot->state;
+    system->state.dirty_pages = ~0u;  // The RAM no longer matches the clone pages
+    system->ext_shift_data = snapshot->ext_shift_data;
+    system->ext_shift_offset = snapshot->ext_shift_offset;
+    system->sound_latch[0] = snapshot->sound_latch[0];
+    system->sound_latch[1] = snapshot->sound_latch[1];
+    system->cocktail_vertical_screen_flip = snapshot->cocktail_vertical_screen_flip;
+    system->scheduler = snapshot->scheduler;
+    system->idle_loops.skipped_cycles = snapshot->idle_skipped_cycles;
+    system->frame_count = snapshot->frame_count;
+}
+
+/**
+ * Execute as many CPU cycles as one video frame takes to be drawn.
+ * The CPU runs in bursts between the timed events (interrupts, input polling) until the end of screen interrupt.
+*/
+void emulate_frame(arcade_system *system) {
+    system->frame_done = 0;
+    while (!system->frame_done) {
+        run_next_event(&system->scheduler, &system->state);
+    }
+}
@@ -5,50 +5,105 @@
 #include "config_rom_loader.h"
 
 /**
- * Load rom file into memory location
+ * CRC32 (as used by MAME and zip) of a memory block
 */
-void load_rom_file(char *filename, uint8_t *memory) {
+uint32_t crc32(uint8_t *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * Load rom file into the ROM bank at the given address and return its CRC32
+*/
+uint32_t load_rom_file(char *filename, uint8_t *rom, int address) {
     int bytes_read;
     struct stat st;
     FILE *file;
 
-    stat(filename, &st);
-
-    if (st.st_size == 0) {
+    if (stat(filename, &st) != 0 || st.st_size == 0) {
         printf("Failed to open the rom file: %s\n", filename);
         exit(-1);
     }
+    if (address < 0 || address + st.st_size > ROM_SIZE) {
+        printf("The rom file does not fit into the ROM area (0x0000 - 0x1FFF): %s\n", filename);
+        exit(-1);
+    }
 
     file = fopen(filename, "rb");
-    bytes_read = fread(memory, 1, st.st_size, file);
+    bytes_read = fread(&rom[address], 1, st.st_size, file);
     fclose(file);
 
     if (bytes_read != st.st_size) {
         printf("Failed to read the rom file: %s\n", filename);
         exit(-1);
     }
+
+    return crc32(&rom[address], st.st_size);
+}
+
+/**
+ * Read the values of an optional configuration line (e.g. INPUT_MODE:) following the keyword
+*/
+void load_config_option(char *keyword, uint8_t *values, int count) {
+    char *pch = strtok (NULL, " ");
+
+    printf("%s\n", keyword);
+    for (int j = 0; j < count && pch != NULL; j++) {
+        values[j] = (int)atoi(pch);
+        printf("%s %d: %d\n", keyword, j + 1, values[j]);
+        pch = strtok (NULL, " ");
+    }
+    printf("-----------------\n");
 }
 
 /**
  * Load the configuration (e.g. dip switch positions) and rom files
 */
 void load_config_rom(arcade_system *system) {
+    load_config_file(system, "invaders.ini");
+}
+
+/**
+ * Load the given configuration file (invaders.ini format) and its rom files
+*/
+void load_config_file(arcade_system *system, char *filename) {
     int i = 0, j = 0;
     int rom_addresses[10];
     char filepath[64];
     char buffer[512];
-    char *filename = "invaders.ini";
     char *pch;
     FILE *file;
 
+    // Optional configuration lines following the 5 mandatory ones. They can appear in any order.
+    struct {
+        char *keyword;
+        uint8_t *values;
+        int count;
+    } options[] = {
+        {"INPUT_MODE:", system->input_mode, sizeof(system->input_mode)},
+        {"RUN_AHEAD:", &system->run_ahead, 1},
+        {"IDLE_SKIP:", &system->idle_skip, 1},
+        {"HLE_MODE:", &system->hle_mode, 1},
+        {"SAMPLE_PROFILE:", &system->sample_profile, 1},
+        {"FRAME_EXPORT:", &system->frame_export, 1},
+        {"RECORD:", &system->record, 1},
+    };
+
     file = fopen(filename, "r");
     if (!file) {
-        printf("Could not open the invaders.ini file!\n");
+        printf("Could not open the %s file!\n", filename);
         exit(1);
     }
 
-    // Read the 5 configuration lines from the invaders.ini file
-    while(fgets(buffer, 512, file) && i < 5) {
+    // Read the 5 configuration lines from the invaders.ini file followed by the optional lines
+    while(fgets(buffer, 512, file)) {
         buffer[strcspn(buffer, "\r\n")] = 0;           // Remove return and new line
         for (size_t i = 0; i < strlen(buffer); i++) {  // Replace tabs with spaces
             if (buffer[i] == 9) {
@@ -56,7 +111,13 @@ void load_config_rom(arcade_system *system) {
             }
         }
         pch = strtok (buffer, " ");
-        if (pch != NULL) {
+        if (pch != NULL && i >= 5) {
+            for (size_t k = 0; k < sizeof(options) / sizeof(options[0]); k++) {
+                if (strcmp(pch, options[k].keyword) == 0) {
+                    load_config_option(pch, options[k].values, options[k].count);
+                }
+            }
+        } else if (pch != NULL) {
             printf("%s\n", pch);
             j = 0;
             while (pch != NULL)
@@ -70,7 +131,8 @@ void load_config_rom(arcade_system *system) {
                         strcpy(filepath, "rom/");
                         strcat(filepath, pch);
                         printf("%s\n", filepath);
-                        load_rom_file(filepath, &system->state.memory[rom_addresses[j - 1]]);
+                        system->rom_crc[j - 1] = load_rom_file(filepath, system->state.rom, rom_addresses[j - 1]);
+                        system->rom_count = j;
                     }
                     if(i==2) { // Read sound sample filenames to load the samples in the sound module
                         strcpy(filepath, "samples/");
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "env_server.h"
+
+#define ALIGN(size) (((size) + 63) & ~(size_t)63)
+
+// Server of this process whose socket file and shared memory are removed at exit (NULL = none)
+env_server *active_server = NULL;
+volatile sig_atomic_t server_interrupted = 0;
+
+/**
+ * Remove the socket file, other files of the same name are left alone
+*/
+void remove_socket_file(const char *socket_path) {
+    struct stat info;
+
+    if (lstat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(socket_path);
+    }
+}
+
+/**
+ * Make the socket path free for a new server: a socket nobody listens on (left by a crashed server) is removed.
+ * Returns 0 if a running server answers on the socket or the path is another file.
+*/
+int remove_stale_socket(const char *socket_path) {
+    struct sockaddr_un address;
+    struct stat info;
+    int probe = 0, result = 0;
+
+    if (lstat(socket_path, &info) != 0) {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        return 0;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        return 0;
+    }
+    result = connect(probe, (struct sockaddr *)&address, sizeof(address)) != 0 && errno == ECONNREFUSED;
+    close(probe);
+    if (result) {
+        unlink(socket_path);
+    }
+    return result;
+}
+
+/**
+ * atexit() handler: a fatal error (exit(1)) while serving must not leave the socket file and the shared memory behind
+*/
+void remove_server_files(void) {
+    if (active_server) {
+        remove_socket_file(active_server->socket_path);
+        shm_unlink(active_server->shared_name);
+        active_server = NULL;
+    }
+}
+
+/**
+ * SIGINT / SIGTERM handler: wake the accept() or recv() of run_env_server(), which then returns.
+ * shutdown() is async-signal-safe, so the handler may run on any thread (e.g. a worker of the thread pool).
+*/
+void interrupt_env_server(int signal) {
+    (void)signal;
+    server_interrupted = 1;
+    if (active_server) {
+        shutdown(active_server->listener, SHUT_RDWR);
+        if (active_server->client >= 0) {
+            shutdown(active_server->client, SHUT_RDWR);
+        }
+    }
+}
+
+/**
+ * Map the shared memory holding the observations, game states and RAM of all instances
+*/
+void create_shared_memory(env_server *server) {
+    int count = server->env->count, fd = 0;
+    size_t observations = ALIGN(sizeof(server_memory));
+    size_t game_states = observations + ALIGN((size_t)count * OBSERVATION_SIZE);
+    size_t ram = game_states + ALIGN(count * sizeof(game_state));
+    uint8_t *base = NULL;
+
+    snprintf(server->shared_name, sizeof(server->shared_name), "/invaders-server-%d", (int)getpid());
+    server->shared_size = ram + (size_t)count * RAM_SIZE;
+    fd = shm_open(server->shared_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        printf("Cannot create the shared memory %s\n", server->shared_name);
+        exit(1);
+    }
+    active_server = server;  // From here on exit() removes the shared memory
+    if (ftruncate(fd, server->shared_size) != 0) {
+        printf("Cannot create the shared memory %s\n", server->shared_name);
+        exit(1);
+    }
+    base = mmap(NULL, server->shared_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("Cannot map the shared memory %s\n", server->shared_name);
+        exit(1);
+    }
+
+    server->memory = (server_memory *)base;
+    server->memory->magic = SERVER_MAGIC;
+    server->memory->count = count;
+    server->memory->steps = 0;
+    server->memory->observations = observations;
+    server->memory->game_states = game_states;
+    server->memory->ram = ram;
+    attach_vector_buffers(server->env, base + observations, (game_state *)(base + game_states));
+}
+
+/**
+ * Serve the instances of a vector environment on a UNIX domain socket. A stale socket file is replaced, a socket of a
+ * running server or any other file of that name is not. The socket file and the shared memory are removed when the
+ * process exits.
+*/
+void create_env_server(env_server *server, vector_env *env, const char *socket_path) {
+    static int cleanup_registered = 0;
+    struct sockaddr_un address;
+
+    server->env = env;
+    server->client = -1;
+    server->listener = -1;
+    memset(server->socket_path, 0, sizeof(server->socket_path));  // Set once the socket file is ours
+    if (!cleanup_registered) {
+        atexit(remove_server_files);
+        cleanup_registered = 1;
+    }
+    create_shared_memory(server);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    if (!remove_stale_socket(socket_path)) {
+        printf("Cannot listen on %s (used by a running server or not a socket)\n", socket_path);
+        exit(1);
+    }
+    server->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listener < 0 || bind(server->listener, (struct sockaddr *)&address, sizeof(address)) != 0
+        || listen(server->listener, 4) != 0) {
+        printf("Cannot listen on %s\n", socket_path);
+        exit(1);
+    }
+    strncpy(server->socket_path, socket_path, sizeof(server->socket_path) - 1);
+}
+
+/**
+ * Receive exactly size bytes, returns 0 when the connection is closed
+*/
+int receive_all(int fd, void *buffer, size_t size) {
+    uint8_t *data = buffer;
+    size_t received = 0;
+    ssize_t bytes = 0;
+
+    while (received < size && (bytes = recv(fd, &data[received], size - received, 0)) > 0) {
+        received += bytes;
+    }
+    return received == size;
+}
+
+/**
+ * Send a response with its payload, returns 0 when the connection is closed
+*/
+int send_response(int fd, int status, const void *payload, size_t size) {
+    server_response response = {status, size};
+
+    return send(fd, &response, sizeof(response), MSG_NOSIGNAL) == sizeof(response)
+           && (size == 0 || send(fd, payload, size, MSG_NOSIGNAL) == (ssize_t)size);
+}
+
+/**
+ * Handle the requests of one client, returns 0 after SERVER_SHUTDOWN
+*/
+int serve_client(env_server *server, int fd, uint8_t *inputs) {
+    vector_env *env = server->env;
+    server_request request;
+    server_info info;
+    int status = SERVER_OK;
+
+    while (receive_all(fd, &request, sizeof(request))) {
+        if (request.size > (uint32_t)env->count || !receive_all(fd, inputs, request.size)) {
+            return 1;  // Protocol error: drop the client
+        }
+        status = SERVER_OK;
+        switch (request.command) {
+        case SERVER_INFO:
+            memset(&info, 0, sizeof(info));
+            info.magic = SERVER_MAGIC;
+            info.version = SERVER_VERSION;
+            info.count = env->count;
+            info.game_states = env->ram_map != NULL;
+            info.shared_size = server->shared_size;
+            memcpy(info.shared_name, server->shared_name, sizeof(info.shared_name));
+            if (!send_response(fd, SERVER_OK, &info, sizeof(info))) {
+                return 1;
+            }
+            continue;
+        case SERVER_RESET:
+            if (request.argument < -1 || request.argument >= env->count) {
+                status = SERVER_BAD_ARGUMENT;
+                break;
+            }
+            reset_vector_env(env, request.argument);
+            break;
+        case SERVER_STEP:
+            if (request.size != (uint32_t)env->count) {
+                status = SERVER_BAD_ARGUMENT;
+                break;
+            }
+            step_vector_env(env, inputs);
+            server->memory->steps++;
+            break;
+        case SERVER_FETCH_RAM:
+            for (int i = 0; i < env->count; i++) {
+                memcpy((uint8_t *)server->memory + server->memory->ram + (size_t)i * RAM_SIZE, env->instances[i].state.ram, RAM_SIZE);
+            }
+            break;
+        case SERVER_SHUTDOWN:
+            send_response(fd, SERVER_OK, NULL, 0);
+            return 0;
+        default:
+            status = SERVER_BAD_COMMAND;
+            break;
+        }
+        if (!send_response(fd, status, NULL, 0)) {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Serve one client after the other until a client sends SERVER_SHUTDOWN or SIGINT / SIGTERM arrives
+*/
+void run_env_server(env_server *server) {
+    uint8_t *inputs = malloc(server->env->count);
+    struct sigaction action, old_interrupt, old_terminate;
+    int running = 1, fd = 0;
+
+    if (!inputs) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = interrupt_env_server;  // No SA_RESTART: a blocked accept() or recv() returns
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &old_interrupt);
+    sigaction(SIGTERM, &action, &old_terminate);
+
+    while (running && !server_interrupted) {
+        fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                usleep(100000);  // Out of descriptors or memory: back off instead of spinning
+            } else if (errno != EINTR && errno != ECONNABORTED && !server_interrupted) {
+                printf("Cannot accept clients on %s\n", server->socket_path);
+                break;
+            }
+            continue;
+        }
+        server->client = fd;
+        if (server_interrupted) {
+            shutdown(fd, SHUT_RDWR);  // The signal came between accept() and the client assignment
+        }
+        running = serve_client(server, fd, inputs);
+        server->client = -1;
+        close(fd);
+    }
+
+    sigaction(SIGINT, &old_interrupt, NULL);
+    sigaction(SIGTERM, &old_terminate, NULL);
+    free(inputs);
+}
+
+/**
+ * Remove the socket file and the shared memory. The vector environment must not be stepped afterwards.
+*/
+void destroy_env_server(env_server *server, const char *socket_path) {
+    close(server->listener);
+    remove_socket_file(socket_path);
+    munmap(server->memory, server->shared_size);
+    shm_unlink(server->shared_name);
+    if (active_server == server) {
+        active_server = NULL;
+    }
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_export.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Shared memory of the emulator, written by the emulation thread only
+frame_export_header *export_header = NULL;
+size_t export_size = 0;
+char export_name[64] = "";
+
+/**
+ * Create the shared memory rings when FRAME_EXPORT is configured (number of frame slots). The object name contains
+ * the pid, so emulators running side by side do not share an object and an existing object is never replaced.
+*/
+void initialize_frame_export(arcade_system *system) {
+    int slots = system->frame_export, fd = 0;
+    size_t sound_offset = (sizeof(frame_export_header) + 63) & ~(size_t)63;
+    size_t frame_offset = sound_offset + ((SOUND_EVENT_SLOTS * sizeof(sound_event) + 63) & ~(size_t)63);
+
+    if (!slots) {
+        return;
+    }
+    export_size = frame_offset + slots * sizeof(export_frame);
+    snprintf(export_name, sizeof(export_name), FRAME_EXPORT_PREFIX "%d", (int)getpid());
+    fd = shm_open(export_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        printf("Cannot create the shared memory %s\n", export_name);
+        exit(1);
+    }
+    if (ftruncate(fd, export_size) != 0) {
+        printf("Cannot create the shared memory %s\n", export_name);
+        shm_unlink(export_name);
+        exit(1);
+    }
+    export_header = mmap(NULL, export_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (export_header == MAP_FAILED) {
+        printf("Cannot map the shared memory %s\n", export_name);
+        shm_unlink(export_name);
+        exit(1);
+    }
+
+    // The new object is zero filled: no frames and no events yet
+    export_header->version = FRAME_EXPORT_VERSION;
+    export_header->width = GAME_WIDTH;
+    export_header->height = GAME_HEIGHT;
+    export_header->frame_slots = slots;
+    export_header->sound_slots = SOUND_EVENT_SLOTS;
+    export_header->frame_offset = frame_offset;
+    export_header->sound_offset = sound_offset;
+    __atomic_store_n(&export_header->magic, FRAME_EXPORT_MAGIC, __ATOMIC_RELEASE);  // Readers wait for the magic
+    printf("Frame export: %d frames in the shared memory %s\n", slots, export_name);
+}
+
+/**
+ * Copy the drawn frame into the next slot of the frame ring
+*/
+void publish_frame(arcade_system *system, const uint32_t *pixels) {
+    uint64_t number = export_header->frames;
+    export_frame *frame = (export_frame *)((uint8_t *)export_header + export_header->frame_offset) + number % export_header->frame_slots;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    __atomic_store_n(&frame->sequence, 2 * number + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);  // Readers see the odd sequence before any new pixel
+    memcpy(frame->pixels, pixels, sizeof(frame->pixels));
+    frame->frame_count = system->frame_count;
+    frame->time_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+    frame->flags = (system->arcade_mode[0] ? EXPORT_COLOR : 0) | (system->arcade_mode[1] ? EXPORT_ROTATE : 0)
+                   | (system->arcade_mode[2] == 1 ? EXPORT_FLIP : 0)
+                   | (system->cocktail_vertical_screen_flip && system->arcade_mode[5] ? EXPORT_COCKTAIL : 0);
+    __atomic_store_n(&frame->sequence, 2 * number + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&export_header->frames, number + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Sound event hook: append a change of the port 3 or 5 sound latch to the event ring (before the latch is updated).
+ * The cycle stamp is the master cycle counter of the last scheduler event, i.e. it has half a frame resolution.
+*/
+void export_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data) {
+    uint64_t number = export_header->sound_events;
+    sound_event *event = (sound_event *)((uint8_t *)export_header + export_header->sound_offset) + number % SOUND_EVENT_SLOTS;
+
+    __atomic_store_n(&event->sequence, 2 * number + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event->cycles = system->scheduler.cycles;
+    event->frame_count = system->frame_count;
+    event->port = port_number;
+    event->data = port_data;
+    event->previous = system->sound_latch[port_number == 3 ? 0 : 1];
+    __atomic_store_n(&event->sequence, 2 * number + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&export_header->sound_events, number + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Remove the shared memory, attached readers keep their mapping until they detach
+*/
+void close_frame_export(void) {
+    if (!export_header) {
+        return;
+    }
+    munmap(export_header, export_size);
+    shm_unlink(export_name);
+    export_header = NULL;
+}
+
+/**
+ * Name of the shared memory object of this emulator (empty without the frame export)
+*/
+const char *frame_export_name(void) {
+    return export_header ? export_name : "";
+}
+
+/**
+ * Map the shared memory of a running emulator read only, returns NULL if it does not exist (yet)
+*/
+const frame_export_header *attach_frame_export(const char *name, size_t *size) {
+    const frame_export_header *header = NULL;
+    struct stat info;
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(frame_export_header)
+        || (header = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    *size = info.st_size;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != FRAME_EXPORT_MAGIC || header->version != FRAME_EXPORT_VERSION) {
+        munmap((void *)header, info.st_size);
+        return NULL;
+    }
+    return header;
+}
+
+/**
+ * Copy the newest complete frame, returns its number (-1 = none yet). Retries if the writer overtakes the copy.
+*/
+int64_t read_export_frame(const frame_export_header *header, export_frame *frame) {
+    const export_frame *frames = (const export_frame *)((const uint8_t *)header + header->frame_offset);
+    const export_frame *slot = NULL;
+    uint64_t number = 0, sequence = 0;
+
+    for (;;) {
+        number = __atomic_load_n(&header->frames, __ATOMIC_ACQUIRE);
+        if (number == 0) {
+            return -1;
+        }
+        number--;
+        slot = &frames[number % header->frame_slots];
+        sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != 2 * number + 2) {
+            continue;  // Already overwritten by a newer frame
+        }
+        memcpy(frame, slot, sizeof(*frame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);  // The copy is complete before the sequence is checked again
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+            frame->sequence = sequence;
+            return number;
+        }
+    }
+}
+
+/**
+ * Copy the sound events from *position on (up to max_events) and advance the position, returns the number of
+ * copied events. A reader which fell behind by more than the ring size skips the lost events.
+*/
+int read_sound_events(const frame_export_header *header, uint64_t *position, sound_event *events, int max_events) {
+    const sound_event *ring = (const sound_event *)((const uint8_t *)header + header->sound_offset);
+    uint64_t end = __atomic_load_n(&header->sound_events, __ATOMIC_ACQUIRE);
+    int count = 0;
+
+    while (*position < end && count < max_events) {
+        const sound_event *slot = &ring[*position % header->sound_slots];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        if (sequence == 2 * *position + 2) {
+            events[count] = *slot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+                count++;
+                (*position)++;
+                continue;
+            }
+        }
+        // Overwritten: continue with the oldest event still in the ring
+        end = __atomic_load_n(&header->sound_events, __ATOMIC_ACQUIRE);
+        if (end > header->sound_slots && *position < end - header->sound_slots + 1) {
+            *position = end - header->sound_slots + 1;
+        }
+    }
+    return count;
+}
+
+#else
+
+// No POSIX shared memory on Windows
+
+void initialize_frame_export(arcade_system *system) {
+    if (system->frame_export) {
+        printf("The frame export is not supported on this platform\n");
+        system->frame_export = 0;
+    }
+}
+
+void publish_frame(arcade_system *system, const uint32_t *pixels) { (void)system; (void)pixels; }
+void export_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data) { (void)system; (void)port_number; (void)port_data; }
+void close_frame_export(void) {}
+const char *frame_export_name(void) { return ""; }
+const frame_export_header *attach_frame_export(const char *name, size_t *size) { (void)name; (void)size; return NULL; }
+int64_t read_export_frame(const frame_export_header *header, export_frame *frame) { (void)header; (void)frame; return -1; }
+int read_sound_events(const frame_export_header *header, uint64_t *position, sound_event *events, int max_events) {
+    (void)header; (void)position; (void)events; (void)max_events;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include <stddef.h>
+#include "game_state.h"
+
+// Space Invaders (Midway): variables in 0x2000 - 0x20FF, player data blocks at 0x2100 and 0x2200
+const game_ram_map invaders_ram_map = {
+    "invaders", {0x734f5ad8, 0x6bfaca4a, 0x0ccead96, 0x14e538b0},
+    {0x20F8, 0x20FA}, 0x20F4, 0x20EB, 0x2067, 0xFF, 0x00, 0x2082, 0x20EF, 0x2015, 0x201B,
+    {0x2025, 0x2029, 0x202A},
+    {{0x2035, 0x203D, 0x203E}, {0x2045, 0x204D, 0x204E}, {0x2055, 0x205D, 0x205E}},
+    0x2084, 0x2088
+};
+
+// Known ROM sets
+const game_ram_map *game_ram_maps[] = {&invaders_ram_map};
+
+/**
+ * RAM map of the loaded ROM set (NULL = unknown). Most bootlegs keep the variables of the Midway ROMs,
+ * invaders_ram_map can be given for them.
+*/
+const game_ram_map *find_game_ram_map(arcade_system *system) {
+    int match = 0;
+
+    for (size_t i = 0; i < sizeof(game_ram_maps) / sizeof(game_ram_maps[0]); i++) {
+        match = system->rom_count == 4;
+        for (int j = 0; j < 4 && match; j++) {
+            match = system->rom_crc[j] == game_ram_maps[i]->rom_crc[j];
+        }
+        if (match) {
+            return game_ram_maps[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 2 digit BCD byte to binary
+*/
+uint32_t bcd_value(uint8_t bcd) {
+    return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+/**
+ * RAM byte at a CPU address
+*/
+uint8_t ram_byte(const uint8_t *ram, uint16_t address) {
+    return ram[(address - RAM_START) & (RAM_SIZE - 1)];
+}
+
+/**
+ * Decode the game variables straight from the RAM of an instance (state.ram), e.g. after each frame
+*/
+void read_game_state(const uint8_t *ram, const game_ram_map *map, game_state *game) {
+    uint16_t player_data = ram_byte(ram, map->player_data) == 0x22 ? 0x2200 : 0x2100;  // 0 before the game initialized it
+
+    for (int i = 0; i < 2; i++) {
+        game->score[i] = bcd_value(ram_byte(ram, map->score[i] + 1)) * 100 + bcd_value(ram_byte(ram, map->score[i]));
+    }
+    game->high_score = bcd_value(ram_byte(ram, map->high_score + 1)) * 100 + bcd_value(ram_byte(ram, map->high_score));
+    game->invaders = 0;
+    for (int i = 0; i < INVADER_COUNT; i++) {
+        game->invaders |= (uint64_t)(ram_byte(ram, player_data + map->invaders + i) != 0) << i;
+    }
+    game->credits = bcd_value(ram_byte(ram, map->credits));
+    game->player = player_data == 0x2200 ? 2 : 1;
+    game->ships = ram_byte(ram, player_data + map->ships);
+    game->game_running = ram_byte(ram, map->game_mode);
+    game->invader_count = ram_byte(ram, map->invader_count);
+    game->player_alive = ram_byte(ram, map->player_alive);
+    game->player_x = ram_byte(ram, map->player_x);
+    for (int i = 0; i < 3; i++) {
+        game->player_shot[i] = ram_byte(ram, map->player_shot[i]);
+        for (int shot = 0; shot < 3; shot++) {
+            game->invader_shot[shot][i] = ram_byte(ram, map->invader_shot[shot][i]);
+        }
+    }
+    game->ufo_active = ram_byte(ram, map->ufo_active);
+    game->ufo_x = ram_byte(ram, map->ufo_x);
+}
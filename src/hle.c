@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include "hle.h"
+
+// -- ClearScreen: 1A5F  MVI M,0 / INX H / MOV A,H / CPI 40 / JNZ 1A5F --
+
+int clear_screen_iterations(Cpu_state *state) {
+    uint16_t address = (state->regs[H] << 8) | state->regs[L];
+
+    if (address < 0x2000 || address >= 0x4000) {
+        return 0;
+    }
+    return 0x4000 - address;
+}
+
+void clear_screen_run(Cpu_state *state, int iterations) {
+    uint16_t address = (state->regs[H] << 8) | state->regs[L];
+
+    for (int i = 0; i < iterations; i++) {
+        write_memory(state, address, 0);
+        address++;
+    }
+    state->regs[H] = address >> 8;
+    state->regs[L] = address & 0xff;
+    state->regs[A] = state->regs[H];
+}
+
+// -- BlockCopy: 1A32  LDAX D / MOV M,A / INX H / INX D / DCR B / JNZ 1A32 --
+
+int block_count_iterations(Cpu_state *state) {
+    return state->regs[B] ? state->regs[B] : 256;
+}
+
+void block_copy_run(Cpu_state *state, int iterations) {
+    uint16_t source = (state->regs[D] << 8) | state->regs[E];
+    uint16_t destination = (state->regs[H] << 8) | state->regs[L];
+
+    for (int i = 0; i < iterations; i++) {
+        state->regs[A] = read_memory(state, source);
+        write_memory(state, destination, state->regs[A]);
+        source++;
+        destination++;
+    }
+    state->regs[D] = source >> 8;
+    state->regs[E] = source & 0xff;
+    state->regs[H] = destination >> 8;
+    state->regs[L] = destination & 0xff;
+    state->regs[B] -= iterations;
+}
+
+// -- DrawShiftedSprite row loop: 1405  PUSH B / PUSH H / LDAX D / OUT 4 / IN 3 / ORA M / MOV M,A / INX H / INX D / XRA A /
+//    OUT 4 / IN 3 / ORA M / MOV M,A / POP H / LXI B,0020 / DAD B / POP B / DCR B / JNZ 1405 --
+
+void shifted_sprite_run(Cpu_state *state, int iterations) {
+    const io_bus *bus = state->bus;
+    uint16_t source = (state->regs[D] << 8) | state->regs[E];
+    uint16_t screen = (state->regs[H] << 8) | state->regs[L];
+    uint16_t sp = state->sp;
+    uint8_t rows = state->regs[B];
+    uint8_t byte = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        // PUSH B and PUSH H leave the saved registers on the stack
+        write_memory(state, sp - 1, rows);
+        write_memory(state, sp - 2, state->regs[C]);
+        write_memory(state, sp - 3, screen >> 8);
+        write_memory(state, sp - 4, screen & 0xff);
+
+        bus->write[4](state->device, 4, read_memory(state, source));
+        byte = bus->read[3](state->device, 3) | read_memory(state, screen);
+        write_memory(state, screen, byte);
+        bus->write[4](state->device, 4, 0);
+        byte = bus->read[3](state->device, 3) | read_memory(state, screen + 1);
+        write_memory(state, screen + 1, byte);
+
+        source++;
+        screen += 0x20;  // Next row
+        rows--;
+    }
+    state->regs[A] = byte;
+    state->regs[B] = rows;
+    state->regs[D] = source >> 8;
+    state->regs[E] = source & 0xff;
+    state->regs[H] = screen >> 8;
+    state->regs[L] = screen & 0xff;
+}
+
+const hle_routine clear_screen = {
+    "ClearScreen", 0x1A5F,
+    {0x36, 0x00, 0x23, 0x7C, 0xFE, 0x40, 0xC2, 0x5F, 0x1A}, 9,
+    10 + 5 + 5 + 7 + 10,
+    clear_screen_iterations, clear_screen_run
+};
+
+const hle_routine block_copy = {
+    "BlockCopy", 0x1A32,
+    {0x1A, 0x77, 0x23, 0x13, 0x05, 0xC2, 0x32, 0x1A}, 8,
+    7 + 7 + 5 + 5 + 5 + 10,
+    block_count_iterations, block_copy_run
+};
+
+const hle_routine shifted_sprite = {
+    "DrawShiftedSprite", 0x1405,
+    {0xC5, 0xE5, 0x1A, 0xD3, 0x04, 0xDB, 0x03, 0xB6, 0x77, 0x23, 0x13, 0xAF, 0xD3, 0x04,
+     0xDB, 0x03, 0xB6, 0x77, 0xE1, 0x01, 0x20, 0x00, 0x09, 0xC1, 0x05, 0xC2, 0x05, 0x14}, 28,
+    11 + 11 + 7 + 10 + 10 + 7 + 7 + 5 + 5 + 4 + 10 + 10 + 7 + 7 + 10 + 10 + 10 + 10 + 5 + 10,
+    block_count_iterations, shifted_sprite_run
+};
+
+// Known ROM sets and their hot routines
+const hle_rom_set hle_rom_sets[] = {
+    {"invaders", {0x734f5ad8, 0x6bfaca4a, 0x0ccead96, 0x14e538b0}, {&clear_screen, &block_copy, &shifted_sprite}},
+};
+
+/**
+ * Compare the arcade system with a snapshot
+*/
+int same_arcade_state(arcade_system *system, arcade_snapshot *snapshot) {
+    Cpu_state *a = &system->state;
+    Cpu_state *b = &snapshot->state;
+
+    for (int i = 0; i < 7; i++) {
+        if (a->regs[i] != b->regs[i]) return 0;
+    }
+    for (int i = 0; i < RAM_SIZE; i++) {
+        if (a->ram[i] != b->ram[i]) return 0;
+    }
+    return a->sp == b->sp && a->pc == b->pc && a->int_enable == b->int_enable && a->halted == b->halted
+        && a->cc.z == b->cc.z && a->cc.s == b->cc.s && a->cc.p == b->cc.p && a->cc.cy == b->cc.cy && a->cc.ac == b->cc.ac
+        && system->ext_shift_data == snapshot->ext_shift_data && system->ext_shift_offset == snapshot->ext_shift_offset
+        && system->sound_latch[0] == snapshot->sound_latch[0] && system->sound_latch[1] == snapshot->sound_latch[1]
+        && system->cocktail_vertical_screen_flip == snapshot->cocktail_vertical_screen_flip;
+}
+
+/**
+ * Scheduler entry hook: run the loop iterations natively which end before the deadline.
+ * In verification mode the native result is compared with the interpreted one.
+*/
+uint64_t run_hle(void *device, Cpu_state *state, uint64_t cycles, uint64_t deadline) {
+    arcade_system *system = device;
+    const hle_routine *routine = system->rom_bank->hle_active[system->rom_bank->hle_entry[state->pc] - 1];
+    arcade_snapshot before, native;  // Verification mode only
+    int64_t iterations = routine->iterations(state) - 1;  // The last iteration is interpreted
+    uint64_t end = 0;
+
+    if ((int64_t)((deadline - cycles) / routine->cycles) < iterations) {
+        iterations = (deadline - cycles) / routine->cycles;  // The interrupt arrives within the loop
+    }
+    if (iterations <= 0) {
+        return cycles;
+    }
+    end = cycles + iterations * routine->cycles;
+
+    if (system->hle_mode == 2) {
+        save_arcade_state(system, &before);
+        routine->run(state, iterations);
+        save_arcade_state(system, &native);
+        load_arcade_state(system, &before);
+
+        while (cycles < end) {
+            cycles += exec_opcode(state);
+        }
+        native.state.cc = state->cc;  // Flags are dead at the loop head: each iteration sets them before use
+        if (cycles != end || !same_arcade_state(system, &native)) {
+            printf("HLE verification failed: %s at %04X\n", routine->name, routine->head);
+            system->hle_mismatches++;
+        }
+        return cycles;  // Continue with the interpreted result
+    }
+
+    routine->run(state, iterations);
+    system->hle_cycles += end - cycles;
+    return end;
+}
+
+/**
+ * Known ROM set of the loaded ROM files (NULL = unknown)
+*/
+const hle_rom_set *find_hle_rom_set(arcade_system *system) {
+    const hle_rom_set *rom_set = NULL;
+    int match = 0;
+
+    for (size_t i = 0; i < sizeof(hle_rom_sets) / sizeof(hle_rom_sets[0]); i++) {
+        match = system->rom_count == 4;
+        for (int j = 0; j < 4 && match; j++) {
+            match = system->rom_crc[j] == hle_rom_sets[i].rom_crc[j];
+        }
+        if (match) {
+            rom_set = &hle_rom_sets[i];
+        }
+    }
+    return rom_set;
+}
+
+/**
+ * Enter the routines of the ROM set matching the ROM content into the tables of the ROM bank (once per ROM bank)
+*/
+void match_hle_routines(arcade_system *system) {
+    const hle_rom_set *rom_set = find_hle_rom_set(system);
+    const hle_routine *routine = NULL;
+    rom_bank *bank = system->rom_bank;
+    int active = 0, match = 0;
+
+    memset(bank->hle_entry, 0, sizeof(bank->hle_entry));
+    for (int i = 0; rom_set && i < MAX_HLE_ROUTINES && rom_set->routines[i]; i++) {
+        routine = rom_set->routines[i];
+        match = 1;
+        for (int j = 0; j < routine->length; j++) {
+            match = match && read_memory(&system->state, routine->head + j) == routine->signature[j];
+        }
+        if (match) {
+            bank->hle_active[active] = routine;
+            bank->hle_entry[routine->head] = ++active;
+        }
+    }
+}
+
+/**
+ * Activate the routines of the loaded ROM set matching the ROM content
+*/
+void initialize_hle(arcade_system *system) {
+    const hle_rom_set *rom_set = NULL;
+    const hle_routine *routine = NULL;
+    rom_bank *bank = system->rom_bank;
+    int active = 0;
+
+    system->hle_cycles = 0;
+    system->hle_mismatches = 0;
+    if (system->hle_mode == 0) {
+        return;
+    }
+
+    rom_set = find_hle_rom_set(system);
+    if (rom_set == NULL) {
+        printf("HLE: unknown ROM set (CRC32:");
+        for (int j = 0; j < system->rom_count; j++) {
+            printf(" %08x", system->rom_crc[j]);
+        }
+        printf(")\n");
+        return;
+    }
+
+    for (int i = 0; i < MAX_HLE_ROUTINES && rom_set->routines[i]; i++) {
+        routine = rom_set->routines[i];
+        if (bank->hle_entry[routine->head] && bank->hle_active[bank->hle_entry[routine->head] - 1] == routine) {
+            active++;
+            printf("HLE %s: %s at %04X\n", rom_set->name, routine->name, routine->head);
+        } else {
+            printf("HLE %s: %s does not match the ROM content\n", rom_set->name, routine->name);
+        }
+    }
+
+    if (active) {
+        system->scheduler.hook_entry = bank->hle_entry;
+        system->scheduler.hook = run_hle;
+        system->scheduler.hook_device = system;
+    }
+}
+
+/**
+ * Print the share of natively executed cycles and the verification result
+*/
+void report_hle(arcade_system *system) {
+    if (system->hle_mode == 1) {
+        printf("HLE: %5.1f%% of the CPU cycles executed natively\n", 100.0 * system->hle_cycles / system->scheduler.cycles);
+    }
+    if (system->hle_mode == 2) {
+        printf("HLE verification: %u mismatches\n", system->hle_mismatches);
+    }
+}
@@ -2,14 +2,16 @@
 // * Intel 8080 Emulation
 // * Reference: The Intel 8080 CPU code (i8080.h, i8080.c) comes from the 
 // *            MIT licensed GitHub project: intarga/i8080e (Ingrid Rebecca Abraham).
-// *            It has been adapted by adding the port handling.
+// *            It has been adapted by adding the port handling via the I/O bus.
 // ****************************************************************************************
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include "i8080.h"
-#include "i8080_ports.h"
+#ifdef PROFILE
+#include "profiler.h"
+#endif
 
 uint8_t check_parity(uint8_t res, int bits) {
     int p = 0;
@@ -984,7 +986,7 @@ int IN(Cpu_state *state) {
     state->pc++;
 
     uint8_t port_number = read_memory(state, state->pc);  // Read the port number
-    state->regs[A] = read_port(port_number);  // Callback into i8080_ports.c
+    state->regs[A] = state->bus->read[port_number](state->device, port_number);  // Device handler on the I/O bus
 
     return 10;
 }
@@ -993,7 +995,7 @@ int OUT(Cpu_state *state) {
     state->pc++;
 
     uint8_t port_number = read_memory(state, state->pc);  // Read the port number
-    write_port(port_number, state->regs[A]);  // Callback into i8080_ports.c
+    state->bus->write[port_number](state->device, port_number, state->regs[A]);  // Device handler on the I/O bus
 
     return 10;
 }
@@ -1001,10 +1003,12 @@ int OUT(Cpu_state *state) {
 // -- HLT --
 
 int HLT(Cpu_state *state) {
-    if (state->int_enable) {
-        //TODO
+    if (!state->int_enable) {
+        exit(0); // No interrupt can end the halt state
     }
-    exit(0); //TODO implement interrupt response
+
+    state->halted = 1;
+    state->pc--;  // Stay on the HLT instruction until the next interrupt
     return 7;
 }
 
@@ -1016,27 +1020,38 @@ uint8_t read_memory(Cpu_state *state, uint16_t address) {
         exit(1);
     }
 
-    if (address >= 0x4000 && address < 0x6000) {
-        address -= 0x2000; // Attention => Shadow RAM mapping only for Space Invaders
-    }
-
-    return state->memory[address];
+    // Both banks are 8K: the offset is the same for the RAM and its shadow at 0x4000 - 0x5FFF
+    // Attention => Shadow RAM mapping only for Space Invaders
+    return (address < RAM_START ? state->rom : state->ram)[address & (RAM_SIZE - 1)];
 }
 
 void write_memory(Cpu_state *state, uint16_t address, uint8_t value) {
-    if (address >= 0x2000) {
-        if (address >= 0x4000 && address < 0x6000) {
-            address -= 0x2000; // Attention => Shadow RAM mapping only for Space Invaders
-        }
-        state->memory[address] = value;
+    if (address >= state->rom_end) {
+        // Low memory is only writable without ROM (rom_end 0, e.g. CP/M test programs)
+        // Attention => Shadow RAM mapping only for Space Invaders
+        (address < RAM_START ? state->rom : state->ram)[address & (RAM_SIZE - 1)] = value;
+        state->dirty_pages |= 1u << ((address & (RAM_SIZE - 1)) / RAM_PAGE_SIZE);
     }
 }
 
 int interrupt(Cpu_state *state, uint16_t offset) {
+#ifdef PROFILE
+    uint16_t pc = state->pc;
+#endif
+    int cyc = 0;
+
     if (state->int_enable) {
+        if (state->halted) {
+            state->halted = 0;
+            state->pc++;  // Return to the instruction following HLT
+        }
         state->pc -= 3;
         state->int_enable = 0;
-        return RST(state, offset);
+        cyc = RST(state, offset);
+#ifdef PROFILE
+        profile_interrupt(state, pc, cyc);
+#endif
+        return cyc;
     }
 
     return 0;
@@ -1046,6 +1061,10 @@ int interrupt(Cpu_state *state, uint16_t offset) {
 
 int exec_opcode(Cpu_state *state) {
     uint8_t op_code = read_memory(state, state->pc);
+#ifdef PROFILE
+    uint16_t pc = state->pc;
+    uint16_t sp = state->sp;
+#endif
 
     int cyc = 0;
 
@@ -1340,6 +1359,9 @@ int exec_opcode(Cpu_state *state) {
     }
 
     state->pc++;
+#ifdef PROFILE
+    profile_opcode(state, pc, sp, op_code, cyc);
+#endif
 
     return cyc;
 }
\ No newline at end of file
@@ -1,99 +1,204 @@
 #include <stdio.h>
 #include "i8080_ports.h"
-#include "sdl_sound.h"
 
-arcade_system *g_system;
+// Port 0, 1 and 2 bits driven by each input word bit. Player 1 & 2 are mapped on the same controls.
+const uint8_t input_port_bits[8][3] = {
+    {0x20, 0x20, 0x20},  // INPUT_LEFT   => Left button (port 0), Player one left (port 1), Player two left (port 2)
+    {0x40, 0x40, 0x40},  // INPUT_RIGHT  => Right button, Player one right, Player two right
+    {0x10, 0x10, 0x10},  // INPUT_SHOT   => Fire button, Player one fire, Player two fire
+    {0x00, 0x04, 0x00},  // INPUT_START1 => One player button
+    {0x00, 0x02, 0x00},  // INPUT_START2 => Two players button
+    {0x00, 0x01, 0x00},  // INPUT_COIN   => Coin Slot
+    {0x00, 0x00, 0x04},  // INPUT_TILT   => TILT Switch
+    {0x00, 0x00, 0x00}
+};
 
 /**
- * Setter to provide the arcade system pointer
+ * Prepare the DIP switch part of the input ports 0, 1 and 2.
+ * Must be called after the DIP switches have been loaded or changed.
 */
-void set_arcade_system(arcade_system *system) {
-    g_system = system;
+void initialize_input_ports(arcade_system *system) {
+    // ATTENTION: DIP switch inputs are inverted
+    system->input_port_dip[0] = (1 - system->dip_switches[2])  // SW3 = ON for RAM & sound checking
+        | (system->dip_switches[4] << 1)                       // Always 1
+        | (system->dip_switches[5] << 2)                       // Always 1
+        | (system->dip_switches[6] << 3);                      // Always 1
+
+    system->input_port_dip[1] = (1 << 3)                       // ?
+        | (1 << 7);                                            // ?
+
+    // SW 1 & 2 switches: number of ships (11 = 3 ships, 01 = 5 ships, 10 = 4 ships, 00 = 6 ships)
+    system->input_port_dip[2] = (1 - system->dip_switches[0])  // SW1
+        | ((1 - system->dip_switches[1]) << 1)                 // SW2
+        | ((1 - system->dip_switches[3]) << 3)                 // SW4   0 = extra ship at 1500, 1 = extra ship at 1000
+        | ((1 - system->dip_switches[7]) << 7);                // SW8 Coin info displayed in demo screen 0 = ON
+
+    set_input_word(system, system->input);
 }
 
 /**
- * Called from the i8080.c cpu emulation to read the port input for the given port number
+ * Set the whole input word (e.g. to replay recorded inputs) and rebuild the input ports
 */
-uint8_t read_port(uint8_t port_number) {
-    uint8_t port_data = 0;  // Holds the port data
+void set_input_word(arcade_system *system, uint8_t input) {
+    system->input = input;
+    for (int port = 0; port < 3; port++) {
+        system->input_port[port] = system->input_port_dip[port];
+        for (int i = 0; i < 8; i++) {
+            if (input & (1 << i)) {
+                system->input_port[port] |= input_port_bits[i][port];
+            }
+        }
+    }
+}
 
-    // ATTENTION: DIP switch inputs are inverted
-    switch (port_number) {
-    case 0:
-        port_data = (1 - g_system->dip_switches[2])  // SW3 = ON for RAM & sound checking 
-        | (g_system->dip_switches[4] << 1)           // Always 1
-        | (g_system->dip_switches[5] << 2)           // Always 1
-        | (g_system->dip_switches[6] << 3)           // Always 1
-        | (g_system->shot << 4)                      // Fire button
-        | (g_system->left << 5)                      // Left button
-        | (g_system->right << 6);                    // Right button
-        break;
-    case 1:
-        port_data = g_system->coin     // Coin Slot
-            | (g_system->start2 << 1)  // Two players button
-            | (g_system->start1 << 2)  // One player button
-            | (1 << 3)                 // ?
-            | (g_system->shot << 4)    // Player one - Fire button
-            | (g_system->left << 5)    // Player one - Left button
-            | (g_system->right << 6)   // Player one - Right button
-            | (1 << 7);                // ?
-        break;
-    case 2:
-        // SW 1 & 2 switches: number of ships (11 = 3 ships, 01 = 5 ships, 10 = 4 ships, 00 = 6 ships)
-        port_data = (1 - g_system->dip_switches[0])    // SW1
-            | ((1 - g_system->dip_switches[1]) << 1)   // SW2 
-            | ((g_system->tilt) << 2)                  // TILT Switch
-            | ((1 - g_system->dip_switches[3]) << 3)   // SW4   0 = extra ship at 1500, 1 = extra ship at 1000
-            | (g_system->shot << 4)                    // Player two - Fire button
-            | (g_system->left << 5)                    // Player two - Left button
-            | (g_system->right << 6)                   // Player two - Right button
-            | ((1 - g_system->dip_switches[7]) << 7);  // SW8 Coin info displayed in demo screen 0 = ON
-        break;
-    case 3:
-        port_data = g_system->ext_shift_data >> (8 - g_system->ext_shift_offset); // 0-7 external shift register data input
-        break;
+/**
+ * Update the input port bits driven by the given input word bits
+*/
+void update_input_ports(arcade_system *system, uint8_t bits, int state) {
+    for (int i = 0; i < 8; i++) {
+        if (bits & (1 << i)) {
+            for (int port = 0; port < 3; port++) {
+                if (state) {
+                    system->input_port[port] |= input_port_bits[i][port];
+                } else {
+                    system->input_port[port] &= ~input_port_bits[i][port];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Input ports 0, 1 and 2: ready-made by the input handling (DIP switches and controls)
+*/
+uint8_t read_input_port(void *device, uint8_t port_number) {
+    arcade_system *system = device;
+
+    if (system->input_pending && system->input_port_read) {
+        system->input_port_read(system, port_number);  // Input latency measurement: the game sees the changed input now
     }
 
-    return port_data;
+    return system->input_port[port_number];
 }
 
 /**
- * Called from the i8080.c cpu emulation to write data to the specific port number.
- * Play sound when the port bit changes from 0 to 1.
+ * Input port 3: external shift register data input
 */
-void write_port(uint8_t port_number, uint8_t port_data) {
-    static uint8_t port_data_mem[2] = {0, 0};
-
-    switch (port_number) {
-    case 2:
-        g_system->ext_shift_offset = port_data & 0x07;  // bit 0,1,2 the shifting amount requested
-        break;
-    case 3:
-        if ((port_data & 0x01) && !(port_data_mem[0] & 0x01)) play_sound(0);  // UFO_F
-        if ((port_data & 0x02) && !(port_data_mem[0] & 0x02)) play_sound(1);  // MISSL (Player shot)
-        if ((port_data & 0x04) && !(port_data_mem[0] & 0x04)) play_sound(2);  // LAU_H (Flash)
-        if ((port_data & 0x08) && !(port_data_mem[0] & 0x08)) play_sound(3);  // INV_H (Invader hit)
-        if ((port_data & 0x10) && !(port_data_mem[0] & 0x10)) play_sound(4);  // EXTRA (Extended play)
-        port_data_mem[0] = port_data;
-        break;
-    case 4:
-        g_system->ext_shift_data = (g_system->ext_shift_data >> 8) | (port_data << 8); // bit 0-7 shift data (LSB on 1st write, MSB on 2nd)
-        break;
-    case 5:
-        if ((port_data & 0x01) && !(port_data_mem[1] & 0x01)) play_sound(5);  // INV_1 (Fleet movement 1)
-        if ((port_data & 0x02) && !(port_data_mem[1] & 0x02)) play_sound(6);  // INV_2 (Fleet movement 2)
-        if ((port_data & 0x04) && !(port_data_mem[1] & 0x04)) play_sound(7);  // INV_3 (Fleet movement 3)
-        if ((port_data & 0x08) && !(port_data_mem[1] & 0x08)) play_sound(8);  // INV_4 (Fleet movement 4)
-        if ((port_data & 0x10) && !(port_data_mem[1] & 0x10)) play_sound(9);  // UFO_H (UFO Hit)
-        if (port_data & 0x20) {
-            g_system->cocktail_vertical_screen_flip = 1;                      // Flip the screen vertically for a 2P SI cocktail table game
-        } else {
-            g_system->cocktail_vertical_screen_flip = 0;
-        }
+uint8_t read_shift_register(void *device, uint8_t port_number) {
+    arcade_system *system = device;
+    (void)port_number;
+
+    return system->ext_shift_data >> (8 - system->ext_shift_offset); // 0-7 external shift register data input
+}
+
+/**
+ * Output port 2: external shift register shift amount
+*/
+void write_shift_amount(void *device, uint8_t port_number, uint8_t port_data) {
+    arcade_system *system = device;
+    (void)port_number;
+
+    system->ext_shift_offset = port_data & 0x07;  // bit 0,1,2 the shifting amount requested
+}
+
+/**
+ * Output port 4: external shift register data
+*/
+void write_shift_data(void *device, uint8_t port_number, uint8_t port_data) {
+    arcade_system *system = device;
+    (void)port_number;
+
+    system->ext_shift_data = (system->ext_shift_data >> 8) | (port_data << 8); // bit 0-7 shift data (LSB on 1st write, MSB on 2nd)
+}
 
-        break;
-    case 6:
-        // printf("Port 6 (Watchdog): %d\n", port_data);
-        break;
+/**
+ * Play a sound sample on the frontend unless the sound output is muted (e.g. run-ahead frames)
+*/
+void trigger_sound(arcade_system *system, int sample_num) {
+    if (!system->sound_mute && system->play_sound) {
+        system->play_sound(sample_num);
+    }
+}
+
+/**
+ * Report a change of a sound latch to the frontend (e.g. the frame export) unless the sound output is muted
+*/
+void report_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data, uint8_t latch) {
+    if (port_data != latch && !system->sound_mute && system->sound_event) {
+        system->sound_event(system, port_number, port_data);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Output port 3: sound latch 1. Play sound when the port bit changes from 0 to 1.
+*/
+void write_sound_latch_1(void *device, uint8_t port_number, uint8_t port_data) {
+    arcade_system *system = device;
+    uint8_t latch = system->sound_latch[0];
+
+    report_sound_event(system, port_number, port_data, latch);
+    if ((port_data & 0x01) && !(latch & 0x01)) trigger_sound(system, 0);  // UFO_F
+    if ((port_data & 0x02) && !(latch & 0x02)) trigger_sound(system, 1);  // MISSL (Player shot)
+    if ((port_data & 0x04) && !(latch & 0x04)) trigger_sound(system, 2);  // LAU_H (Flash)
+    if ((port_data & 0x08) && !(latch & 0x08)) trigger_sound(system, 3);  // INV_H (Invader hit)
+    if ((port_data & 0x10) && !(latch & 0x10)) trigger_sound(system, 4);  // EXTRA (Extended play)
+    system->sound_latch[0] = port_data;
+}
+
+/**
+ * Output port 5: sound latch 2 and the cocktail table screen flip
+*/
+void write_sound_latch_2(void *device, uint8_t port_number, uint8_t port_data) {
+    arcade_system *system = device;
+    uint8_t latch = system->sound_latch[1];
+
+    report_sound_event(system, port_number, port_data, latch);
+    if ((port_data & 0x01) && !(latch & 0x01)) trigger_sound(system, 5);  // INV_1 (Fleet movement 1)
+    if ((port_data & 0x02) && !(latch & 0x02)) trigger_sound(system, 6);  // INV_2 (Fleet movement 2)
+    if ((port_data & 0x04) && !(latch & 0x04)) trigger_sound(system, 7);  // INV_3 (Fleet movement 3)
+    if ((port_data & 0x08) && !(latch & 0x08)) trigger_sound(system, 8);  // INV_4 (Fleet movement 4)
+    if ((port_data & 0x10) && !(latch & 0x10)) trigger_sound(system, 9);  // UFO_H (UFO Hit)
+    system->sound_latch[1] = port_data;
+
+    if (port_data & 0x20) {
+        system->cocktail_vertical_screen_flip = 1;  // Flip the screen vertically for a 2P SI cocktail table game
+    } else {
+        system->cocktail_vertical_screen_flip = 0;
+    }
+}
+
+/**
+ * Output port 6: watchdog
+*/
+void write_watchdog(void *device, uint8_t port_number, uint8_t port_data) {
+    (void)device;
+    (void)port_number;
+    (void)port_data;
+    // printf("Port 6 (Watchdog): %d\n", port_data);
+}
+
+// Port handlers of the Space Invaders board, the same for all instances (the device context is the arcade system)
+const io_bus si_board_bus = {
+    .read = {
+        [0 ... 2] = read_input_port,
+        [3] = read_shift_register,
+        [4 ... 255] = unmapped_read,
+    },
+    .write = {
+        [0 ... 1] = unmapped_write,
+        [2] = write_shift_amount,
+        [3] = write_sound_latch_1,
+        [4] = write_shift_data,
+        [5] = write_sound_latch_2,
+        [6] = write_watchdog,
+        [7 ... 255] = unmapped_write,
+    },
+};
+
+/**
+ * Connect the Space Invaders board devices to the CPU of the arcade system
+*/
+void attach_si_board(arcade_system *system) {
+    system->state.bus = &si_board_bus;
+    system->state.device = system;
+}
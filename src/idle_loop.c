@@ -0,0 +1,147 @@
+#include <stddef.h>
+#include "idle_loop.h"
+
+/**
+ * Clear the loop cache
+*/
+void initialize_idle_loops(idle_loops *idle) {
+    for (int i = 0; i < IDLE_LOOP_CACHE; i++) {
+        idle->cache[i].head = 0;
+        idle->cache[i].jump = 0;
+        idle->cache[i].status = LOOP_UNKNOWN;
+    }
+    idle->skipped_cycles = 0;
+}
+
+/**
+ * Length of an instruction which only reads memory and changes registers and flags.
+ * Returns 0 for instructions with other side effects (memory writes, stack, I/O, interrupts, calls).
+*/
+int pure_instruction_length(uint8_t op_code) {
+    if (op_code >= 0x40 && op_code <= 0x7f) {
+        return (op_code >= 0x70 && op_code <= 0x77) ? 0 : 1;  // MOV M,r writes the memory and 0x76 is HLT
+    }
+    if (op_code >= 0x80 && op_code <= 0xbf) {
+        return 1;  // ADD, ADC, SUB, SBB, ANA, XRA, ORA, CMP
+    }
+
+    switch (op_code) {
+    case 0x00:                                                        // NOP
+    case 0x03: case 0x13: case 0x23: case 0x33:                       // INX
+    case 0x0b: case 0x1b: case 0x2b: case 0x3b:                       // DCX
+    case 0x09: case 0x19: case 0x29: case 0x39:                       // DAD
+    case 0x04: case 0x0c: case 0x14: case 0x1c: case 0x24: case 0x2c: case 0x3c:  // INR r
+    case 0x05: case 0x0d: case 0x15: case 0x1d: case 0x25: case 0x2d: case 0x3d:  // DCR r
+    case 0x0a: case 0x1a:                                             // LDAX
+    case 0x07: case 0x0f: case 0x17: case 0x1f:                       // RLC, RRC, RAL, RAR
+    case 0x27: case 0x2f: case 0x37: case 0x3f:                       // DAA, CMA, STC, CMC
+    case 0xeb: case 0xf9:                                             // XCHG, SPHL
+        return 1;
+    case 0x06: case 0x0e: case 0x16: case 0x1e: case 0x26: case 0x2e: case 0x3e:  // MVI r
+    case 0xc6: case 0xce: case 0xd6: case 0xde: case 0xe6: case 0xee: case 0xf6: case 0xfe:  // ALU immediate
+        return 2;
+    case 0x01: case 0x11: case 0x21: case 0x31:                       // LXI
+    case 0x2a: case 0x3a:                                             // LHLD, LDA
+    case 0xc3: case 0xc2: case 0xca: case 0xd2: case 0xda: case 0xe2: case 0xea: case 0xf2: case 0xfa:  // JMP, Jcc
+        return 3;
+    }
+
+    return 0;
+}
+
+/**
+ * Check that the code from the loop head up to the backward jump has no side effects
+*/
+uint8_t analyze_loop(Cpu_state *state, uint16_t head, uint16_t jump) {
+    uint16_t pc = head;
+    uint8_t op_code = 0;
+    int length = 0;
+
+    if (jump < head || jump - head > IDLE_LOOP_MAX_BYTES) {
+        return LOOP_NOT_PURE;
+    }
+
+    while (pc < jump) {
+        length = pure_instruction_length(read_memory(state, pc));
+        if (length == 0) {
+            return LOOP_NOT_PURE;
+        }
+        pc += length;
+    }
+
+    op_code = read_memory(state, jump);
+    if (pc != jump || (op_code != 0xc3 && (op_code & 0xc7) != 0xc2)) {
+        return LOOP_NOT_PURE;  // The loop must end with JMP or a conditional jump
+    }
+    if ((read_memory(state, jump + 1) | (read_memory(state, jump + 2) << 8)) != head) {
+        return LOOP_NOT_PURE;
+    }
+
+    return LOOP_PURE;
+}
+
+/**
+ * Called after a backward jump from the given address (or HLT). If the CPU is waiting in a loop which
+ * cannot end before the next event, the remaining whole loop iterations are credited without executing them.
+ * The resulting machine state is identical to executing them.
+ * Returns the new master cycle counter value.
+*/
+uint64_t skip_idle_loop(idle_loops *idle, Cpu_state *state, uint16_t jump, uint64_t cycles, uint64_t deadline) {
+    uint16_t head = state->pc;
+    idle_loop *loop = &idle->cache[head % IDLE_LOOP_CACHE];
+    uint8_t status = loop->status;
+    uint64_t start = 0, skip = 0;
+    uint8_t regs[7];
+    uint16_t sp = state->sp;
+    Condition_codes cc = state->cc;
+
+    if (state->halted) {
+        // HLT is repeated every 7 cycles until the interrupt arrives
+        if (cycles < deadline) {
+            skip = (deadline - cycles + 6) / 7 * 7;
+            idle->skipped_cycles += skip;
+            cycles += skip;
+        }
+        return cycles;
+    }
+
+    if (status == LOOP_UNKNOWN || loop->head != head || loop->jump != jump) {
+        status = analyze_loop(state, head, jump);
+        if (jump < 0x2000) {  // Only loops in ROM can be cached
+            loop->head = head;
+            loop->jump = jump;
+            loop->status = status;
+        }
+    }
+    if (status != LOOP_PURE) {
+        return cycles;
+    }
+
+    // Execute one iteration: it must end at the loop head with unchanged registers and flags
+    for (int i = 0; i < 7; i++) {
+        regs[i] = state->regs[i];
+    }
+    start = cycles;
+    do {
+        if (cycles >= deadline || state->pc < head || state->pc > jump) {
+            return cycles;  // The event is due or the loop has been left
+        }
+        cycles += exec_opcode(state);
+    } while (state->pc != head);
+
+    for (int i = 0; i < 7; i++) {
+        if (state->regs[i] != regs[i]) return cycles;
+    }
+    if (state->sp != sp || state->cc.z != cc.z || state->cc.s != cc.s || state->cc.p != cc.p
+        || state->cc.cy != cc.cy || state->cc.ac != cc.ac) {
+        return cycles;
+    }
+
+    // Every further iteration is identical: skip all that would start before the deadline
+    if (cycles < deadline) {
+        skip = (deadline - 1 - cycles) / (cycles - start) * (cycles - start);
+        idle->skipped_cycles += skip;
+        cycles += skip;
+    }
+    return cycles;
+}
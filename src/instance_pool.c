@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "instance_pool.h"
+
+/**
+ * Map the arena: reserved huge pages if requested and available, otherwise normal pages with the
+ * transparent huge page hint. Returns the pages actually used.
+*/
+int map_arena(instance_pool *pool, int pages) {
+    pool->arena = MAP_FAILED;
+    if (pages == POOL_HUGE_PAGES) {
+        pool->arena_size = (pool->arena_size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        pool->arena = mmap(NULL, pool->arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pool->arena != MAP_FAILED) {
+            return POOL_HUGE_PAGES;
+        }
+        pages = POOL_TRANSPARENT_PAGES;  // No huge pages reserved (vm.nr_hugepages)
+    }
+    pool->arena = mmap(NULL, pool->arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool->arena == MAP_FAILED) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    if (pages == POOL_TRANSPARENT_PAGES && madvise(pool->arena, pool->arena_size, MADV_HUGEPAGE) == 0) {
+        return POOL_TRANSPARENT_PAGES;
+    }
+    return POOL_SMALL_PAGES;
+}
+
+/**
+ * Create a pool of machine slots copied from a started template, which must outlive the pool.
+ * The slots are taken in ascending order, so the first acquired instances form an array.
+*/
+void create_instance_pool(instance_pool *pool, const arcade_system *template, int capacity, int pages) {
+    pool->template = template;
+    pool->capacity = capacity;
+    pool->arena_size = (size_t)capacity * sizeof(arcade_system);
+    pool->pages = map_arena(pool, pages);
+    pool->free_slots = malloc(capacity * sizeof(int));
+    if (!pool->free_slots) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    for (int i = 0; i < capacity; i++) {
+        pool->free_slots[i] = capacity - 1 - i;
+    }
+    pool->free_count = capacity;
+}
+
+/**
+ * Slot number to instance
+*/
+arcade_system *pool_instance(instance_pool *pool, int slot) {
+    return (arcade_system *)(pool->arena + (size_t)slot * sizeof(arcade_system));
+}
+
+/**
+ * Take a free slot and reset it to the template, NULL when the pool is exhausted
+*/
+arcade_system *acquire_instance(instance_pool *pool) {
+    arcade_system *system = NULL;
+
+    if (pool->free_count == 0) {
+        return NULL;
+    }
+    system = pool_instance(pool, pool->free_slots[--pool->free_count]);
+    copy_arcade_machine(system, pool->template);
+    return system;
+}
+
+/**
+ * Reset an instance to the template (e.g. at the end of an episode)
+*/
+void reset_pool_instance(instance_pool *pool, arcade_system *system) {
+    copy_arcade_machine(system, pool->template);
+}
+
+/**
+ * Return the slot of an instance to the pool
+*/
+void release_instance(instance_pool *pool, arcade_system *system) {
+    pool->free_slots[pool->free_count++] = ((uint8_t *)system - pool->arena) / sizeof(arcade_system);
+}
+
+/**
+ * Unmap the arena, all instances of the pool become invalid
+*/
+void destroy_instance_pool(instance_pool *pool) {
+    munmap(pool->arena, pool->arena_size);
+    free(pool->free_slots);
+    pool->arena = NULL;
+    pool->free_slots = NULL;
+    pool->free_count = 0;
+}
@@ -0,0 +1,44 @@
+#include <stddef.h>
+#include "io_bus.h"
+
+/**
+ * Unmapped input ports read as 0
+*/
+uint8_t unmapped_read(void *device, uint8_t port_number) {
+    (void)device;
+    (void)port_number;
+    return 0;
+}
+
+/**
+ * Writes to unmapped output ports are ignored
+*/
+void unmapped_write(void *device, uint8_t port_number, uint8_t port_data) {
+    (void)device;
+    (void)port_number;
+    (void)port_data;
+}
+
+/**
+ * Reset all 256 input and output ports to unmapped
+*/
+void initialize_io_bus(io_bus *bus) {
+    for (int i = 0; i < 256; i++) {
+        bus->read[i] = unmapped_read;
+        bus->write[i] = unmapped_write;
+    }
+}
+
+/**
+ * Connect a device handler to an input port (IN instruction)
+*/
+void map_read_port(io_bus *bus, uint8_t port_number, port_read_handler handler) {
+    bus->read[port_number] = handler;
+}
+
+/**
+ * Connect a device handler to an output port (OUT instruction)
+*/
+void map_write_port(io_bus *bus, uint8_t port_number, port_write_handler handler) {
+    bus->write[port_number] = handler;
+}
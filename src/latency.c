@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include "latency.h"
+
+/**
+ * Reset a latency histogram and give it a name for the report
+*/
+void initialize_latency_histogram(latency_histogram *histogram, char *name) {
+    histogram->name = name;
+    histogram->samples = 0;
+    histogram->sum = 0;
+    histogram->min = 0xFFFFFFFF;
+    histogram->max = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        histogram->count[i] = 0;
+    }
+}
+
+/**
+ * Add one latency sample (µs) to the histogram
+*/
+void record_latency(latency_histogram *histogram, uint32_t usec) {
+    uint32_t bucket = usec / LATENCY_BUCKET_USEC;
+
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;  // The last bucket collects everything above the histogram range
+    }
+    histogram->count[bucket]++;
+    histogram->samples++;
+    histogram->sum += usec;
+    if (usec < histogram->min) histogram->min = usec;
+    if (usec > histogram->max) histogram->max = usec;
+}
+
+/**
+ * Print the histogram including min / mean / max to the console
+*/
+void print_latency_histogram(latency_histogram *histogram) {
+    uint32_t peak = 1;
+
+    printf("Latency: %s (%u samples)\n", histogram->name, histogram->samples);
+    if (histogram->samples == 0) {
+        return;
+    }
+    printf("min %6.3f ms  mean %6.3f ms  max %6.3f ms\n", histogram->min / 1000.0,
+           histogram->sum / 1000.0 / histogram->samples, histogram->max / 1000.0);
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (histogram->count[i] > peak) peak = histogram->count[i];
+    }
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (histogram->count[i] == 0) continue;
+        if (i == LATENCY_BUCKETS - 1) {
+            printf("  >=%-3d ms %6u ", i, histogram->count[i]);
+        } else {
+            printf("%3d-%-3d ms %6u ", i, i + 1, histogram->count[i]);
+        }
+        for (uint32_t bar = 0; bar < 40 * histogram->count[i] / peak; bar++) {
+            printf("#");
+        }
+        printf("\n");
+    }
+}
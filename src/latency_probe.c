@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "latency_probe.h"
+#include "latency.h"
+
+// Measurement stages of a single probe from the input event to the presented frame
+enum Probe_stage {
+    PROBE_IDLE,
+    PROBE_EVENT,    // Waiting for the game to read the changed port bit
+    PROBE_PORT,     // Waiting for the laser base area in the video RAM to change
+    PROBE_VRAM,     // Waiting for SDL_RenderPresent() of the frame showing the change
+};
+
+// The laser base is drawn into the bytes 2 .. 5 of each 32 byte video line (incl. the shot leaving the base)
+#define PROBE_AREA_OFFSET 2
+#define PROBE_AREA_BYTES 4
+
+struct {
+    int stage;
+    uint8_t bit;                 // The probed input bit
+    int frames;                  // Frames since the port read
+    uint64_t event_usec;
+    uint64_t port_usec;
+    uint64_t vram_usec;
+    uint32_t dropped;            // Probes without a visible reaction in the laser base area
+    uint8_t area[224 * PROBE_AREA_BYTES];  // Laser base area when the game read the input
+    latency_histogram event_to_port;
+    latency_histogram port_to_vram;
+    latency_histogram vram_to_present;
+    latency_histogram event_to_present;
+} probe;
+
+/**
+ * Time stamp with µs resolution from the SDL high resolution counter
+*/
+uint64_t probe_time(void) {
+    return SDL_GetPerformanceCounter() * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * Copy the laser base area out of the video RAM
+*/
+void probe_copy_area(arcade_system *system, uint8_t *area) {
+    for (int line = 0; line < 224; line++) {
+        memcpy(&area[line * PROBE_AREA_BYTES], &system->state.ram[0x2400 - RAM_START + line * 32 + PROBE_AREA_OFFSET], PROBE_AREA_BYTES);
+    }
+}
+
+/**
+ * Reset the probe and its histograms
+*/
+void initialize_latency_probe(void) {
+    probe.stage = PROBE_IDLE;
+    probe.dropped = 0;
+    initialize_latency_histogram(&probe.event_to_port, "Input event to port read");
+    initialize_latency_histogram(&probe.port_to_vram, "Port read to laser base VRAM change");
+    initialize_latency_histogram(&probe.vram_to_present, "VRAM change to SDL_RenderPresent");
+    initialize_latency_histogram(&probe.event_to_present, "Input event to SDL_RenderPresent (input-to-photon)");
+}
+
+/**
+ * A probed input has been pressed. The SDL time stamp (ms) tells how long the event waited in the SDL queue.
+*/
+void probe_input_event(arcade_system *system, uint8_t bit, uint32_t timestamp) {
+    uint32_t queued = SDL_GetTicks() - timestamp;
+
+    if (probe.stage == PROBE_IDLE && (bit & PROBE_INPUTS)) {
+        probe.stage = PROBE_EVENT;
+        probe.bit = bit;
+        probe.event_usec = probe_time() - (uint64_t)queued * 1000;
+        system->input_pending |= bit;
+    }
+}
+
+/**
+ * The game read the given changed input bits through an IN instruction
+*/
+void probe_port_read(arcade_system *system, uint8_t bits) {
+    if (probe.stage == PROBE_EVENT && (bits & probe.bit)) {
+        probe.stage = PROBE_PORT;
+        probe.port_usec = probe_time();
+        probe.frames = 0;
+        probe_copy_area(system, probe.area);
+    }
+}
+
+/**
+ * Called after the emulation of a video frame to look for a change of the laser base area
+*/
+void probe_frame_end(arcade_system *system) {
+    uint8_t area[224 * PROBE_AREA_BYTES];
+
+    if (probe.stage != PROBE_PORT) {
+        return;
+    }
+
+    probe_copy_area(system, area);
+    if (memcmp(area, probe.area, sizeof(area)) != 0) {
+        probe.stage = PROBE_VRAM;
+        probe.vram_usec = probe_time();
+    } else if (++probe.frames > PROBE_TIMEOUT_FRAMES) {
+        probe.stage = PROBE_IDLE;  // E.g. the laser base is already at the border or the game is not running
+        probe.dropped++;
+    }
+}
+
+/**
+ * Called when SDL_RenderPresent() returned
+*/
+void probe_frame_presented(void) {
+    uint64_t now = 0;
+
+    if (probe.stage != PROBE_VRAM) {
+        return;
+    }
+
+    now = probe_time();
+    record_latency(&probe.event_to_port, probe.port_usec - probe.event_usec);
+    record_latency(&probe.port_to_vram, probe.vram_usec - probe.port_usec);
+    record_latency(&probe.vram_to_present, now - probe.vram_usec);
+    record_latency(&probe.event_to_present, now - probe.event_usec);
+    probe.stage = PROBE_IDLE;
+}
+
+/**
+ * Print the latency distribution of all stages
+*/
+void report_latency_probe(void) {
+    print_latency_histogram(&probe.event_to_port);
+    print_latency_histogram(&probe.port_to_vram);
+    print_latency_histogram(&probe.vram_to_present);
+    print_latency_histogram(&probe.event_to_present);
+    printf("Probes without visible reaction: %u\n", probe.dropped);
+}
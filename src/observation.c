@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "observation.h"
+#include "video_frame.h"
+
+#define LINE_BYTES 32  // 256 pixels of a CRT line (one upright column, bottom up)
+#define LINE_WORDS 4
+
+// The mean pooling counts the pixels with popcount: on x86-64 a POPCNT variant is selected at run time
+#if defined(__x86_64__) && defined(__linux__)
+#define POPCOUNT_KERNEL __attribute__((target_clones("popcnt", "default")))
+#else
+#define POPCOUNT_KERNEL
+#endif
+
+/**
+ * 64 pixels of a CRT line, bit n = pixel n of the word from the start of the line
+*/
+uint64_t line_word(const uint8_t *line, int word) {
+    uint64_t bits = 0;
+
+    memcpy(&bits, &line[word * 8], sizeof(bits));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    bits = __builtin_bswap64(bits);
+#endif
+    return bits;
+}
+
+/**
+ * Masks of the CRT line pixels first to end - 1
+*/
+void band_masks(int first, int end, uint64_t *masks) {
+    for (int word = 0; word < LINE_WORDS; word++) {
+        int low = first - word * 64, high = end - word * 64;
+
+        low = low < 0 ? 0 : low > 64 ? 64 : low;
+        high = high < 0 ? 0 : high > 64 ? 64 : high;
+        masks[word] = high <= low ? 0 : high - low == 64 ? ~0ULL : ((1ULL << (high - low)) - 1) << low;
+    }
+}
+
+/**
+ * Crop and scale down the upright screen directly from the video RAM (1 bit per pixel) to one byte per pixel.
+ * Each output pixel pools a box of screen pixels. The CRT lines (one upright column each) of an output column are
+ * first combined 64 pixels at a time: ORed for the max pooling, added up in bit slices (slice k = bit k of the
+ * per pixel sums) for the mean. A box is then a bit range of the combined line.
+*/
+POPCOUNT_KERNEL void downsample_frame(const uint8_t *ram, const observation_spec *spec, uint8_t *out) {
+    const uint8_t *video_ram = &ram[VIDEO_RAM - RAM_START];
+    uint64_t masks[UPRIGHT_HEIGHT][LINE_WORDS];  // CRT line pixels of each output row
+    uint8_t first_word[UPRIGHT_HEIGHT], last_word[UPRIGHT_HEIGHT];
+    double row_scale[UPRIGHT_HEIGHT];            // 1 / box height
+    uint64_t slices[9][LINE_WORDS];              // Sums of up to 224 lines
+    int maximum = spec->pooling == OBSERVATION_MAX;
+
+    if (spec->x < 0 || spec->y < 0 || spec->x + spec->width > UPRIGHT_WIDTH || spec->y + spec->height > UPRIGHT_HEIGHT
+        || spec->out_width < 1 || spec->out_height < 1 || spec->out_width > spec->width || spec->out_height > spec->height) {
+        printf("Invalid observation size!\n");
+        exit(1);
+    }
+
+    for (int row = 0; row < spec->out_height; row++) {
+        int top = spec->y + row * spec->height / spec->out_height;
+        int bottom = spec->y + (row + 1) * spec->height / spec->out_height;
+
+        band_masks(UPRIGHT_HEIGHT - bottom, UPRIGHT_HEIGHT - top, masks[row]);  // The lines are drawn bottom up
+        first_word[row] = (UPRIGHT_HEIGHT - bottom) / 64;
+        last_word[row] = (UPRIGHT_HEIGHT - top - 1) / 64;
+        row_scale[row] = 1.0 / (bottom - top);
+    }
+
+    for (int column = 0; column < spec->out_width; column++) {
+        int left = spec->x + column * spec->width / spec->out_width;
+        int right = spec->x + (column + 1) * spec->width / spec->out_width;
+        double scale = 255.0 / (right - left);
+        int slice_count = 1;
+
+        memset(slices, 0, sizeof(slices));
+        for (int x = left; x < right; x++) {
+            for (int word = 0; word < LINE_WORDS; word++) {
+                uint64_t carry = line_word(&video_ram[x * LINE_BYTES], word);
+
+                for (int k = 0; carry && !maximum; k++) {
+                    uint64_t next = slices[k][word] & carry;
+
+                    slices[k][word] ^= carry;
+                    carry = next;
+                    slice_count = k + 1 > slice_count ? k + 1 : slice_count;
+                }
+                slices[0][word] |= carry;  // Max pooling
+            }
+        }
+
+        if (maximum) {
+            for (int row = 0; row < spec->out_height; row++) {
+                uint64_t bits = (slices[0][0] & masks[row][0]) | (slices[0][1] & masks[row][1])
+                                | (slices[0][2] & masks[row][2]) | (slices[0][3] & masks[row][3]);
+
+                out[row * spec->out_width + column] = bits ? 255 : 0;
+            }
+            continue;
+        }
+        for (int row = 0; row < spec->out_height; row++) {
+            int count = 0;
+
+            for (int word = first_word[row]; word <= last_word[row]; word++) {
+                for (int k = 0; k < slice_count; k++) {
+                    count += __builtin_popcountll(slices[k][word] & masks[row][word]) << k;
+                }
+            }
+            // count * 255 / area rounded down: the 0.5 keeps exact quotients above the rounding errors
+            out[row * spec->out_width + column] = (int)((count + 0.5 / 255) * scale * row_scale[row]);
+        }
+    }
+}
+
+/**
+ * Empty stack of the last depth frames
+*/
+void create_frame_stack(frame_stack *stack, int depth, size_t frame_size) {
+    stack->depth = depth;
+    stack->frame_size = frame_size;
+    stack->head = 0;
+    stack->buffer = calloc(2 * depth, frame_size);
+    if (!stack->buffer) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+}
+
+/**
+ * Fill the stack with a frame (e.g. the first frame of an episode), NULL = blank frames
+*/
+void reset_frame_stack(frame_stack *stack, const uint8_t *frame) {
+    for (int slot = 0; slot < 2 * stack->depth; slot++) {
+        if (frame) {
+            memcpy(&stack->buffer[slot * stack->frame_size], frame, stack->frame_size);
+        } else {
+            memset(&stack->buffer[slot * stack->frame_size], 0, stack->frame_size);
+        }
+    }
+    stack->head = 0;
+}
+
+/**
+ * Add the newest frame, the oldest one is dropped
+*/
+void push_frame(frame_stack *stack, const uint8_t *frame) {
+    memcpy(&stack->buffer[stack->head * stack->frame_size], frame, stack->frame_size);
+    memcpy(&stack->buffer[(stack->head + stack->depth) * stack->frame_size], frame, stack->frame_size);
+    stack->head = (stack->head + 1) % stack->depth;
+}
+
+/**
+ * Downsample the video RAM as the newest frame (frame_size = out_width * out_height)
+*/
+void push_observation(frame_stack *stack, const uint8_t *ram, const observation_spec *spec) {
+    uint8_t *frame = &stack->buffer[stack->head * stack->frame_size];
+
+    downsample_frame(ram, spec, frame);
+    memcpy(&stack->buffer[(stack->head + stack->depth) * stack->frame_size], frame, stack->frame_size);
+    stack->head = (stack->head + 1) % stack->depth;
+}
+
+/**
+ * The last depth frames, oldest first (depth * frame_size bytes, valid until the next push)
+*/
+const uint8_t *stacked_frames(const frame_stack *stack) {
+    return &stack->buffer[stack->head * stack->frame_size];
+}
+
+void destroy_frame_stack(frame_stack *stack) {
+    free(stack->buffer);
+    stack->buffer = NULL;
+}
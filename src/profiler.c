@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+
+typedef struct {
+    uint16_t address;
+    char name[32];
+} profile_symbol;
+
+typedef struct {
+    uint16_t entry;
+    uint16_t sp;
+    uint64_t start;
+} profile_frame;
+
+typedef struct {
+    uint64_t pc_count[0x10000];
+    uint64_t pc_cycles[0x10000];
+    uint64_t routine_calls[0x10000];
+    uint64_t routine_cycles[0x10000];  // Inclusive: from the call until the matching return
+    uint64_t opcode_count[256];
+    uint64_t opcode_cycles[256];
+    uint64_t instructions;
+    uint64_t cycles;
+    profile_edge edges[MAX_PROFILE_EDGES];
+    uint32_t dropped_edges;
+    profile_frame stack[PROFILE_STACK_DEPTH];
+    int depth;
+    profile_symbol symbols[MAX_PROFILE_SYMBOLS];
+    int symbol_count;
+} profile_data;
+
+profile_data *profile = NULL;  // Allocated once by initialize_profiler, a production build never touches it
+
+const char *opcode_names[256] = {
+    "NOP", "LXI B", "STAX B", "INX B", "INR B", "DCR B", "MVI B", "RLC",
+    "*NOP", "DAD B", "LDAX B", "DCX B", "INR C", "DCR C", "MVI C", "RRC",
+    "*NOP", "LXI D", "STAX D", "INX D", "INR D", "DCR D", "MVI D", "RAL",
+    "*NOP", "DAD D", "LDAX D", "DCX D", "INR E", "DCR E", "MVI E", "RAR",
+    "*NOP", "LXI H", "SHLD", "INX H", "INR H", "DCR H", "MVI H", "DAA",
+    "*NOP", "DAD H", "LHLD", "DCX H", "INR L", "DCR L", "MVI L", "CMA",
+    "*NOP", "LXI SP", "STA", "INX SP", "INR M", "DCR M", "MVI M", "STC",
+    "*NOP", "DAD SP", "LDA", "DCX SP", "INR A", "DCR A", "MVI A", "CMC",
+    "MOV B,B", "MOV B,C", "MOV B,D", "MOV B,E", "MOV B,H", "MOV B,L", "MOV B,M", "MOV B,A",
+    "MOV C,B", "MOV C,C", "MOV C,D", "MOV C,E", "MOV C,H", "MOV C,L", "MOV C,M", "MOV C,A",
+    "MOV D,B", "MOV D,C", "MOV D,D", "MOV D,E", "MOV D,H", "MOV D,L", "MOV D,M", "MOV D,A",
+    "MOV E,B", "MOV E,C", "MOV E,D", "MOV E,E", "MOV E,H", "MOV E,L", "MOV E,M", "MOV E,A",
+    "MOV H,B", "MOV H,C", "MOV H,D", "MOV H,E", "MOV H,H", "MOV H,L", "MOV H,M", "MOV H,A",
+    "MOV L,B", "MOV L,C", "MOV L,D", "MOV L,E", "MOV L,H", "MOV L,L", "MOV L,M", "MOV L,A",
+    "MOV M,B", "MOV M,C", "MOV M,D", "MOV M,E", "MOV M,H", "MOV M,L", "HLT", "MOV M,A",
+    "MOV A,B", "MOV A,C", "MOV A,D", "MOV A,E", "MOV A,H", "MOV A,L", "MOV A,M", "MOV A,A",
+    "ADD B", "ADD C", "ADD D", "ADD E", "ADD H", "ADD L", "ADD M", "ADD A",
+    "ADC B", "ADC C", "ADC D", "ADC E", "ADC H", "ADC L", "ADC M", "ADC A",
+    "SUB B", "SUB C", "SUB D", "SUB E", "SUB H", "SUB L", "SUB M", "SUB A",
+    "SBB B", "SBB C", "SBB D", "SBB E", "SBB H", "SBB L", "SBB M", "SBB A",
+    "ANA B", "ANA C", "ANA D", "ANA E", "ANA H", "ANA L", "ANA M", "ANA A",
+    "XRA B", "XRA C", "XRA D", "XRA E", "XRA H", "XRA L", "XRA M", "XRA A",
+    "ORA B", "ORA C", "ORA D", "ORA E", "ORA H", "ORA L", "ORA M", "ORA A",
+    "CMP B", "CMP C", "CMP D", "CMP E", "CMP H", "CMP L", "CMP M", "CMP A",
+    "RNZ", "POP B", "JNZ", "JMP", "CNZ", "PUSH B", "ADI", "RST 0",
+    "RZ", "RET", "JZ", "*JMP", "CZ", "CALL", "ACI", "RST 1",
+    "RNC", "POP D", "JNC", "OUT", "CNC", "PUSH D", "SUI", "RST 2",
+    "RC", "*RET", "JC", "IN", "CC", "*CALL", "SBI", "RST 3",
+    "RPO", "POP H", "JPO", "XTHL", "CPO", "PUSH H", "ANI", "RST 4",
+    "RPE", "PCHL", "JPE", "XCHG", "CPE", "*CALL", "XRI", "RST 5",
+    "RP", "POP PSW", "JP", "DI", "CP", "PUSH PSW", "ORI", "RST 6",
+    "RM", "SPHL", "JM", "EI", "CM", "*CALL", "CPI", "RST 7",
+};
+
+const char *edge_names[] = {"CALL", "RST", "INT", "RET"};
+
+/**
+ * Sort the symbols by address for the lookup of the routine containing a PC
+*/
+int compare_symbols(const void *a, const void *b) {
+    return ((const profile_symbol *)a)->address - ((const profile_symbol *)b)->address;
+}
+
+/**
+ * Load the optional symbol file, e.g. "1A5C ClearScreen". Lines starting with ; or # are comments.
+ * The file is named by the INVADERS_SYMBOLS environment variable, default invaders.sym.
+*/
+void load_profile_symbols(void) {
+    char buffer[128];
+    char name[32];
+    unsigned int address = 0;
+    const char *filename = getenv(PROFILE_SYMBOL_VARIABLE) ? getenv(PROFILE_SYMBOL_VARIABLE) : PROFILE_SYMBOL_FILE;
+    FILE *file = fopen(filename, "r");
+
+    if (!file) {
+        printf("Profiler: no %s symbol file, the report shows plain addresses\n", filename);
+        return;
+    }
+    while (fgets(buffer, sizeof(buffer), file) && profile->symbol_count < MAX_PROFILE_SYMBOLS) {
+        if (buffer[0] == ';' || buffer[0] == '#') {
+            continue;
+        }
+        if (sscanf(buffer, "%x %31s", &address, name) == 2) {
+            profile->symbols[profile->symbol_count].address = address;
+            strcpy(profile->symbols[profile->symbol_count].name, name);
+            profile->symbol_count++;
+        }
+    }
+    fclose(file);
+    qsort(profile->symbols, profile->symbol_count, sizeof(profile_symbol), compare_symbols);
+    printf("Profiler: %d symbols loaded from %s\n", profile->symbol_count, filename);
+}
+
+/**
+ * Allocate the counters and load the symbols. The counters are kept for the whole process, further
+ * started machines (e.g. a reset or the instances of a batch) add to them.
+*/
+void initialize_profiler(void) {
+    if (profile) {
+        return;
+    }
+    profile = calloc(1, sizeof(profile_data));
+    if (!profile) {
+        printf("Could not allocate the profiler counters!\n");
+        exit(1);
+    }
+    load_profile_symbols();
+}
+
+/**
+ * Address annotated with the nearest symbol below it, e.g. "1A61 ClearScreen+5"
+*/
+char *format_location(uint16_t address, char *buffer) {
+    int i = profile->symbol_count - 1;
+
+    while (i >= 0 && profile->symbols[i].address > address) {
+        i--;
+    }
+    if (i < 0) {
+        sprintf(buffer, "%04X", address);
+    } else if (profile->symbols[i].address == address) {
+        sprintf(buffer, "%04X %s", address, profile->symbols[i].name);
+    } else {
+        sprintf(buffer, "%04X %s+%d", address, profile->symbols[i].name, address - profile->symbols[i].address);
+    }
+    return buffer;
+}
+
+/**
+ * Count a call graph edge in the open addressing table
+*/
+void record_edge(uint16_t from, uint16_t to, profile_edge_kind kind) {
+    uint32_t slot = ((from * 31u) ^ (to * 7u) ^ kind) % MAX_PROFILE_EDGES;
+
+    for (int i = 0; i < MAX_PROFILE_EDGES; i++) {
+        profile_edge *edge = &profile->edges[slot];
+
+        if (!edge->used) {
+            edge->used = 1;
+            edge->from = from;
+            edge->to = to;
+            edge->kind = kind;
+        }
+        if (edge->from == from && edge->to == to && edge->kind == kind) {
+            edge->count++;
+            return;
+        }
+        slot = (slot + 1) % MAX_PROFILE_EDGES;
+    }
+    profile->dropped_edges++;
+}
+
+/**
+ * Entry of the routine on top of the shadow stack. Interrupt and return edges are counted per routine
+ * instead of per interrupted or returned-to address, which would spread them over the whole loop body.
+*/
+uint16_t current_routine(uint16_t pc) {
+    return profile->depth > 0 ? profile->stack[profile->depth - 1].entry : pc;
+}
+
+/**
+ * A routine has been entered: remember it on the shadow stack for its inclusive cycles
+*/
+void enter_routine(Cpu_state *state) {
+    profile->routine_calls[state->pc]++;
+    if (profile->depth < PROFILE_STACK_DEPTH) {
+        profile->stack[profile->depth].entry = state->pc;
+        profile->stack[profile->depth].sp = state->sp;
+        profile->stack[profile->depth].start = profile->cycles;
+        profile->depth++;
+    }
+}
+
+/**
+ * A return pops the return address at sp: close all routines entered at or below this stack position.
+ * Routines left without a RET (e.g. the stack pointer has been reloaded) are closed with the next outer return.
+*/
+void leave_routine(uint16_t sp) {
+    while (profile->depth > 0 && profile->stack[profile->depth - 1].sp <= sp) {
+        profile->depth--;
+        profile->routine_cycles[profile->stack[profile->depth].entry] += profile->cycles - profile->stack[profile->depth].start;
+    }
+}
+
+/**
+ * Account one executed instruction. pc and sp are the values before the execution.
+*/
+void profile_opcode(Cpu_state *state, uint16_t pc, uint16_t sp, uint8_t op_code, int cycles) {
+    profile->pc_count[pc]++;
+    profile->pc_cycles[pc] += cycles;
+    profile->opcode_count[op_code]++;
+    profile->opcode_cycles[op_code] += cycles;
+    profile->instructions++;
+    profile->cycles += cycles;
+
+    if ((op_code & 0xC7) == 0xC7) {                                  // RST n
+        record_edge(pc, state->pc, EDGE_RST);
+        enter_routine(state);
+    } else if ((op_code == 0xCD || (op_code & 0xC7) == 0xC4) && state->sp == (uint16_t)(sp - 2)) {  // Taken CALL
+        record_edge(pc, state->pc, EDGE_CALL);
+        enter_routine(state);
+    } else if ((op_code == 0xC9 || (op_code & 0xC7) == 0xC0) && state->sp == (uint16_t)(sp + 2)) {  // Taken RET
+        leave_routine(sp);
+        record_edge(pc, current_routine(state->pc), EDGE_RET);
+    }
+}
+
+/**
+ * Account an accepted interrupt. pc is the interrupted address.
+*/
+void profile_interrupt(Cpu_state *state, uint16_t pc, int cycles) {
+    profile->cycles += cycles;
+    record_edge(current_routine(pc), state->pc, EDGE_INT);
+    enter_routine(state);
+}
+
+const uint64_t *sort_key;  // qsort has no context parameter
+
+int compare_descending(const void *a, const void *b) {
+    uint64_t ka = sort_key[*(const uint32_t *)a];
+    uint64_t kb = sort_key[*(const uint32_t *)b];
+
+    return (ka < kb) - (ka > kb);
+}
+
+/**
+ * Indices of the non-zero keys sorted by descending key
+*/
+int sort_indices(const uint64_t *key, uint32_t size, uint32_t *index) {
+    int count = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (key[i]) {
+            index[count++] = i;
+        }
+    }
+    sort_key = key;
+    qsort(index, count, sizeof(uint32_t), compare_descending);
+    return count;
+}
+
+double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+/**
+ * Print the hot spots: instructions, routines (inclusive cycles), opcodes and call graph edges
+*/
+void report_profile(void) {
+    static uint32_t index[0x10000];
+    static uint64_t edge_count[MAX_PROFILE_EDGES];
+    char location[2][64];
+    int count = 0;
+
+    if (!profile) {
+        return;
+    }
+    printf("Profile: %llu instructions, %llu cycles\n", (unsigned long long)profile->instructions,
+        (unsigned long long)profile->cycles);
+
+    printf("\nHot instructions                count        cycles      %%\n");
+    count = sort_indices(profile->pc_cycles, 0x10000, index);
+    for (int i = 0; i < count && i < PROFILE_TOP_ENTRIES; i++) {
+        printf("%-28s %12llu %13llu %6.2f\n", format_location(index[i], location[0]),
+            (unsigned long long)profile->pc_count[index[i]], (unsigned long long)profile->pc_cycles[index[i]],
+            percent(profile->pc_cycles[index[i]], profile->cycles));
+    }
+
+    printf("\nHot routines (inclusive)        calls      cycles      %%\n");
+    count = sort_indices(profile->routine_cycles, 0x10000, index);
+    for (int i = 0; i < count && i < PROFILE_TOP_ENTRIES; i++) {
+        printf("%-28s %12llu %13llu %6.2f\n", format_location(index[i], location[0]),
+            (unsigned long long)profile->routine_calls[index[i]], (unsigned long long)profile->routine_cycles[index[i]],
+            percent(profile->routine_cycles[index[i]], profile->cycles));
+    }
+
+    printf("\nOpcodes                         count        cycles      %%\n");
+    count = sort_indices(profile->opcode_cycles, 256, index);
+    for (int i = 0; i < count; i++) {
+        printf("%02X %-25s %12llu %13llu %6.2f\n", index[i], opcode_names[index[i]],
+            (unsigned long long)profile->opcode_count[index[i]], (unsigned long long)profile->opcode_cycles[index[i]],
+            percent(profile->opcode_cycles[index[i]], profile->cycles));
+    }
+
+    printf("\nCall graph edges                                                     count\n");
+    for (int i = 0; i < MAX_PROFILE_EDGES; i++) {
+        edge_count[i] = profile->edges[i].count;
+    }
+    count = sort_indices(edge_count, MAX_PROFILE_EDGES, index);
+    for (int i = 0; i < count && i < PROFILE_TOP_ENTRIES; i++) {
+        profile_edge *edge = &profile->edges[index[i]];
+
+        printf("%-4s %-28s -> %-28s %12llu\n", edge_names[edge->kind], format_location(edge->from, location[0]),
+            format_location(edge->to, location[1]), (unsigned long long)edge->count);
+    }
+    if (profile->dropped_edges) {
+        printf("%u call graph edges dropped, the edge table is full\n", profile->dropped_edges);
+    }
+}
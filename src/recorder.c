@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "recorder.h"
+#include "config_rom_loader.h"
+#include "video_frame.h"
+#include "observation.h"
+
+#define FRAME_BYTES (GAME_WIDTH * GAME_HEIGHT / 8)                // 1 bit per pixel video RAM
+#define COMPRESSED_MAX (FRAME_BYTES + FRAME_BYTES / 128 + 1)      // Worst case of compress_frame()
+#define ENTRY_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+#define PNG_ROW_BYTES (1 + UPRIGHT_WIDTH / 8)                     // Filter byte and 1 bit per pixel
+#define PNG_RAW_BYTES (PNG_ROW_BYTES * UPRIGHT_HEIGHT)
+
+// Queue of compressed frames: written by the emulation thread, read by the writer thread. The emulation thread
+// never waits: a frame which does not fit is dropped and the writer repeats the previous frame in its place.
+uint8_t *record_queue = NULL;
+uint64_t queue_head = 0;              // Written by the emulation thread only
+uint64_t queue_tail = 0;              // Written by the writer thread only
+int record_stop = 0;
+pthread_t record_thread;
+pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t record_ready = PTHREAD_COND_INITIALIZER;
+
+// Emulation thread
+int record_format = RECORD_OFF;
+uint8_t queued_frame[FRAME_BYTES];    // Base of the next compressed frame
+uint16_t pending_sounds = 0;          // Samples triggered since the last queued frame
+uint64_t frames_queued = 0, frames_dropped = 0;
+
+// Writer thread
+char record_name[128];
+FILE *video_file = NULL, *audio_file = NULL;
+uint8_t written_frame[FRAME_BYTES];
+uint8_t video_buffer[UPRIGHT_HEIGHT * UPRIGHT_WIDTH * 3 / 2];  // Y4M frame or PNG file
+int64_t last_frame_count = -1;
+uint64_t frames_written = 0, audio_samples = 0;
+int16_t *sample_data[10];
+size_t sample_length[10];
+struct {
+    int sample;                       // -1 = free
+    size_t position;
+} voices[RECORD_VOICES];
+
+/**
+ * Little endian values of the WAV file
+*/
+void put_le(uint8_t *out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * Big endian values of the PNG file
+*/
+void put_be(uint8_t *out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+/**
+ * Load a PCM WAV sample (8 or 16 bit, mono or stereo) as 16 bit mono at the recording sample rate
+*/
+void load_record_sample(int index, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    uint8_t *data = NULL, *chunk = NULL, *samples = NULL;
+    long size = 0;
+    uint32_t chunk_size = 0, rate = 0, bytes = 0;
+    int channels = 0, bits = 0, frame_bytes = 0;
+
+    sample_data[index] = NULL;
+    sample_length[index] = 0;
+    if (!file) {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = malloc(size > 0 ? size : 1);
+    if (!data || fread(data, 1, size, file) != (size_t)size || size < 12 || memcmp(data, "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) {
+        fclose(file);
+        free(data);
+        return;
+    }
+    fclose(file);
+
+    // Walk the chunks for the format and the sample data
+    for (chunk = &data[12]; chunk + 8 <= data + size; chunk += 8 + chunk_size + (chunk_size & 1)) {
+        chunk_size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (chunk_size > (size_t)(data + size - chunk - 8)) {
+            chunk_size = data + size - chunk - 8;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && (chunk[8] | chunk[9] << 8) == 1) {
+            channels = chunk[10] | chunk[11] << 8;
+            rate = chunk[12] | chunk[13] << 8 | chunk[14] << 16 | (uint32_t)chunk[15] << 24;
+            bits = chunk[22] | chunk[23] << 8;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            samples = &chunk[8];
+            bytes = chunk_size;
+        }
+    }
+    if (!samples || channels < 1 || !rate || (bits != 8 && bits != 16)) {
+        printf("Recorder: unsupported sound sample %s\n", filename);
+        free(data);
+        return;
+    }
+
+    frame_bytes = channels * bits / 8;
+    sample_length[index] = (uint64_t)(bytes / frame_bytes) * RECORD_SAMPLE_RATE / rate;
+    sample_data[index] = malloc(sample_length[index] * sizeof(int16_t) + 1);
+    if (!sample_data[index]) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < sample_length[index]; i++) {
+        const uint8_t *frame = &samples[(uint64_t)i * rate / RECORD_SAMPLE_RATE * frame_bytes];
+        int sum = 0;
+
+        for (int channel = 0; channel < channels; channel++) {
+            sum += bits == 8 ? (frame[channel] - 128) << 8 : (int16_t)(frame[2 * channel] | frame[2 * channel + 1] << 8);
+        }
+        sample_data[index][i] = sum / channels;
+    }
+    free(data);
+}
+
+/**
+ * XOR the frame with the previous one and run length encode the difference:
+ * 0x80 | (n - 1) = n unchanged bytes, n - 1 followed by n bytes = n changed bytes (XOR values)
+*/
+size_t compress_frame(const uint8_t *frame, const uint8_t *previous, uint8_t *out) {
+    size_t size = 0;
+    int i = 0, n = 0;
+
+    while (i < FRAME_BYTES) {
+        n = 0;
+        if (frame[i] == previous[i]) {
+            while (i + n < FRAME_BYTES && n < 128 && frame[i + n] == previous[i + n]) {
+                n++;
+            }
+            out[size++] = 0x80 | (n - 1);
+        } else {
+            // Single unchanged bytes stay in the literal run
+            while (i + n < FRAME_BYTES && n < 128 && (frame[i + n] != previous[i + n]
+                   || (i + n + 1 < FRAME_BYTES && frame[i + n + 1] != previous[i + n + 1]))) {
+                n++;
+            }
+            out[size++] = n - 1;
+            for (int k = 0; k < n; k++) {
+                out[size++] = frame[i + k] ^ previous[i + k];
+            }
+        }
+        i += n;
+    }
+    return size;
+}
+
+/**
+ * Apply a compressed difference to the frame
+*/
+void decompress_frame(const uint8_t *in, size_t size, uint8_t *frame) {
+    size_t position = 0;
+    int i = 0, n = 0;
+
+    while (position < size && i < FRAME_BYTES) {
+        n = (in[position] & 0x7F) + 1;
+        if (i + n > FRAME_BYTES) {
+            n = FRAME_BYTES - i;
+        }
+        if (in[position++] & 0x80) {
+            i += n;
+            continue;
+        }
+        for (int k = 0; k < n; k++) {
+            frame[i++] ^= in[position++];
+        }
+    }
+}
+
+/**
+ * Pixel of the upright screen (x 0 - 223, y 0 - 255): the CRT lines are drawn bottom up
+*/
+int upright_pixel(const uint8_t *frame, int x, int y) {
+    int bit = GAME_WIDTH - 1 - y;
+
+    return (frame[x * (GAME_WIDTH / 8) + bit / 8] >> (bit % 8)) & 1;
+}
+
+void write_y4m_frame(const uint8_t *frame) {
+    uint8_t *luma = video_buffer;
+
+    for (int y = 0; y < UPRIGHT_HEIGHT; y++) {
+        for (int x = 0; x < UPRIGHT_WIDTH; x++) {
+            *luma++ = upright_pixel(frame, x, y) ? 255 : 0;
+        }
+    }
+    memset(luma, 128, UPRIGHT_HEIGHT * UPRIGHT_WIDTH / 2);  // Neutral chroma
+    fputs("FRAME\n", video_file);
+    fwrite(video_buffer, 1, sizeof(video_buffer), video_file);
+}
+
+/**
+ * Append a PNG chunk, the CRC covers the type and the data
+*/
+size_t png_chunk(uint8_t *out, const char *type, size_t size) {
+    put_be(out, size);
+    memcpy(&out[4], type, 4);
+    put_be(&out[8 + size], crc32(&out[4], size + 4));
+    return size + 12;
+}
+
+/**
+ * 1 bit per pixel gray PNG file, the image data is a zlib stream of one stored deflate block
+*/
+void write_png_frame(const uint8_t *frame) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint8_t *out = video_buffer, *raw = NULL;
+    uint32_t adler_a = 1, adler_b = 0;
+    char filename[160];
+    FILE *file = NULL;
+
+    memcpy(out, signature, 8);
+    out += 8;
+    put_be(&out[8], UPRIGHT_WIDTH);
+    put_be(&out[12], UPRIGHT_HEIGHT);
+    memcpy(&out[16], "\x01\x00\x00\x00\x00", 5);  // Bit depth 1, gray, deflate, no filter, no interlace
+    out += png_chunk(out, "IHDR", 13);
+
+    raw = &out[8 + 2 + 5];
+    memset(raw, 0, PNG_RAW_BYTES);
+    for (int y = 0; y < UPRIGHT_HEIGHT; y++) {
+        uint8_t *row = &raw[y * PNG_ROW_BYTES + 1];  // Filter type 0
+
+        for (int x = 0; x < UPRIGHT_WIDTH; x++) {
+            row[x / 8] |= upright_pixel(frame, x, y) << (7 - x % 8);
+        }
+    }
+    for (int i = 0; i < PNG_RAW_BYTES; i++) {
+        adler_a = (adler_a + raw[i]) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    out[8] = 0x78;
+    out[9] = 0x01;
+    out[10] = 0x01;                               // Final stored block
+    put_le(&out[11], PNG_RAW_BYTES, 2);
+    put_le(&out[13], ~PNG_RAW_BYTES & 0xFFFF, 2);
+    put_be(&raw[PNG_RAW_BYTES], (adler_b << 16) | adler_a);
+    out += png_chunk(out, "IDAT", 2 + 5 + PNG_RAW_BYTES + 4);
+    out += png_chunk(out, "IEND", 0);
+
+    snprintf(filename, sizeof(filename), "%s-%06llu.png", record_name, (unsigned long long)frames_written);
+    file = fopen(filename, "wb");
+    if (file) {
+        fwrite(video_buffer, 1, out - video_buffer, file);
+        fclose(file);
+    }
+}
+
+/**
+ * Mix the samples playing during one frame, the triggered samples start at the beginning of the frame
+*/
+void write_audio_frame(uint16_t sounds) {
+    uint8_t buffer[2 * (RECORD_SAMPLE_RATE / 50)];
+    uint64_t end = (uint64_t)((frames_written + 1) * (RECORD_SAMPLE_RATE / FRAMERATE));
+    int count = end - audio_samples;
+
+    for (int n = 0; n < 10; n++) {
+        for (int v = 0; (sounds & (1 << n)) && sample_length[n] && v < RECORD_VOICES; v++) {
+            if (voices[v].sample < 0) {  // Like the mixer: a sample is skipped if all channels are busy
+                voices[v].sample = n;
+                voices[v].position = 0;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        int sum = 0;
+
+        for (int v = 0; v < RECORD_VOICES; v++) {
+            if (voices[v].sample >= 0) {
+                sum += sample_data[voices[v].sample][voices[v].position++];
+                if (voices[v].position >= sample_length[voices[v].sample]) {
+                    voices[v].sample = -1;
+                }
+            }
+        }
+        put_le(&buffer[2 * i], sum > 32767 ? 32767 : sum < -32768 ? -32768 : sum, 2);
+    }
+    fwrite(buffer, 2, count, audio_file);
+    audio_samples = end;
+}
+
+void write_frame(const uint8_t *frame, uint16_t sounds) {
+    if (record_format == RECORD_Y4M) {
+        write_y4m_frame(frame);
+    } else {
+        write_png_frame(frame);
+    }
+    write_audio_frame(sounds);
+    frames_written++;
+}
+
+/**
+ * Writer thread: decode the queued frames and write them until the recorder is closed and the queue is empty
+*/
+void *record_writer(void *argument) {
+    record_entry entry;
+    uint64_t head = 0, tail = 0;
+    size_t offset = 0;
+
+    (void)argument;
+    for (;;) {
+        head = __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+        if (tail == head) {
+            struct timespec timeout;
+
+            if (__atomic_load_n(&record_stop, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += 20000000;  // The emulation thread only signals when the lock is free
+            if (timeout.tv_nsec >= 1000000000) {
+                timeout.tv_sec++;
+                timeout.tv_nsec -= 1000000000;
+            }
+            pthread_mutex_lock(&record_lock);
+            pthread_cond_timedwait(&record_ready, &record_lock, &timeout);
+            pthread_mutex_unlock(&record_lock);
+            continue;
+        }
+
+        offset = tail % RECORD_QUEUE_SIZE;
+        if (offset + sizeof(entry) > RECORD_QUEUE_SIZE || ((record_entry *)&record_queue[offset])->size == 0) {
+            tail += RECORD_QUEUE_SIZE - offset;  // Skip to the start of the queue
+            continue;
+        }
+        memcpy(&entry, &record_queue[offset], sizeof(entry));
+        if (last_frame_count < 0) {
+            last_frame_count = entry.frame_count - 1;
+        }
+        while ((int64_t)entry.frame_count > last_frame_count + 1) {
+            write_frame(written_frame, 0);  // Dropped frame: repeat the previous one to keep the timing
+            last_frame_count++;
+        }
+        decompress_frame(&record_queue[offset + sizeof(entry)], entry.size, written_frame);
+        tail += ENTRY_ALIGN(sizeof(entry) + entry.size);
+        __atomic_store_n(&queue_tail, tail, __ATOMIC_RELEASE);
+
+        write_frame(written_frame, entry.sounds);
+        last_frame_count = entry.frame_count;
+    }
+    return NULL;
+}
+
+/**
+ * Open the recording files (name NULL = invaders-<date>-<time>) and start the writer thread when RECORD is configured
+*/
+void initialize_recorder(arcade_system *system, const char *name) {
+    uint8_t header[44];
+    char filename[160];
+    time_t now = time(NULL);
+
+    record_format = system->record;
+    if (record_format == RECORD_OFF) {
+        return;
+    }
+    if (record_format != RECORD_Y4M && record_format != RECORD_PNG) {
+        printf("Unknown recording format %d\n", record_format);
+        exit(1);
+    }
+    if (name) {
+        snprintf(record_name, sizeof(record_name), "%s", name);
+    } else {
+        strftime(record_name, sizeof(record_name), "invaders-%Y%m%d-%H%M%S", localtime(&now));
+    }
+
+    if (record_format == RECORD_Y4M) {
+        snprintf(filename, sizeof(filename), "%s.y4m", record_name);
+        video_file = fopen(filename, "wb");
+        if (!video_file) {
+            printf("Could not create the %s file!\n", filename);
+            exit(1);
+        }
+        fprintf(video_file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", UPRIGHT_WIDTH, UPRIGHT_HEIGHT,
+            (int)(FRAMERATE * 50000 + 0.5), 50000);
+    }
+    snprintf(filename, sizeof(filename), "%s.wav", record_name);
+    audio_file = fopen(filename, "wb");
+    if (!audio_file) {
+        printf("Could not create the %s file!\n", filename);
+        exit(1);
+    }
+    memset(header, 0, sizeof(header));  // The sizes are filled in by close_recorder()
+    memcpy(header, "RIFF\0\0\0\0WAVEfmt ", 16);
+    put_le(&header[16], 16, 4);
+    put_le(&header[20], 1, 2);                       // PCM
+    put_le(&header[22], 1, 2);                       // Mono
+    put_le(&header[24], RECORD_SAMPLE_RATE, 4);
+    put_le(&header[28], 2 * RECORD_SAMPLE_RATE, 4);  // Bytes per second
+    put_le(&header[32], 2, 2);
+    put_le(&header[34], 16, 2);
+    memcpy(&header[36], "data", 4);
+    fwrite(header, 1, sizeof(header), audio_file);
+
+    for (int i = 0; i < 10; i++) {
+        load_record_sample(i, system->sample_filepath[i]);
+    }
+    for (int v = 0; v < RECORD_VOICES; v++) {
+        voices[v].sample = -1;
+    }
+
+    record_queue = malloc(RECORD_QUEUE_SIZE);
+    if (!record_queue) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    memset(queued_frame, 0, sizeof(queued_frame));
+    memset(written_frame, 0, sizeof(written_frame));
+    queue_head = queue_tail = 0;
+    record_stop = 0;
+    pending_sounds = 0;
+    frames_queued = frames_dropped = frames_written = audio_samples = 0;
+    last_frame_count = -1;
+    if (pthread_create(&record_thread, NULL, record_writer, NULL) != 0) {
+        printf("Could not start the recorder thread!\n");
+        exit(1);
+    }
+    printf("Recording to %s.%s and %s.wav\n", record_name, record_format == RECORD_Y4M ? "y4m" : "*.png", record_name);
+}
+
+/**
+ * Sound event hook: remember the samples started by the change of a sound latch for the next recorded frame
+*/
+void record_sound_event(arcade_system *system, uint8_t port_number, uint8_t port_data) {
+    uint8_t latch = system->sound_latch[port_number == 3 ? 0 : 1];
+    uint8_t started = port_data & ~latch & 0x1F;
+
+    pending_sounds |= port_number == 3 ? started : started << 5;
+}
+
+/**
+ * Queue the video RAM of the emulated frame, compressed against the previous queued frame. Never waits for the
+ * writer thread: if the queue is full the frame is dropped (and repeated in the recording).
+*/
+void record_frame(arcade_system *system) {
+    const uint8_t *frame = &system->state.ram[VIDEO_RAM - RAM_START];
+    uint64_t head = queue_head, tail = __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE);
+    size_t offset = head % RECORD_QUEUE_SIZE;
+    uint64_t skip = 0;
+    record_entry *entry = NULL;
+
+    if (offset + sizeof(record_entry) + COMPRESSED_MAX > RECORD_QUEUE_SIZE) {
+        skip = RECORD_QUEUE_SIZE - offset;  // Entries are contiguous, continue at the start of the queue
+    }
+    if (head + skip + ENTRY_ALIGN(sizeof(record_entry) + COMPRESSED_MAX) - tail > RECORD_QUEUE_SIZE) {
+        frames_dropped++;
+        return;
+    }
+    if (skip) {
+        if (offset + sizeof(record_entry) <= RECORD_QUEUE_SIZE) {
+            ((record_entry *)&record_queue[offset])->size = 0;
+        }
+        head += skip;
+        offset = 0;
+    }
+
+    entry = (record_entry *)&record_queue[offset];
+    entry->size = compress_frame(frame, queued_frame, &record_queue[offset + sizeof(record_entry)]);
+    entry->sounds = pending_sounds;
+    entry->frame_count = system->frame_count;
+    memcpy(queued_frame, frame, FRAME_BYTES);
+    pending_sounds = 0;
+    frames_queued++;
+    __atomic_store_n(&queue_head, head + ENTRY_ALIGN(sizeof(record_entry) + entry->size), __ATOMIC_RELEASE);
+
+    if (pthread_mutex_trylock(&record_lock) == 0) {  // Wake up the writer unless that would mean waiting
+        pthread_cond_signal(&record_ready);
+        pthread_mutex_unlock(&record_lock);
+    }
+}
+
+/**
+ * Write the remaining queued frames, complete the files and stop the writer thread
+*/
+void close_recorder(void) {
+    uint8_t size[4];
+
+    if (record_format == RECORD_OFF) {
+        return;
+    }
+    __atomic_store_n(&record_stop, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&record_lock);
+    pthread_cond_signal(&record_ready);
+    pthread_mutex_unlock(&record_lock);
+    pthread_join(record_thread, NULL);
+
+    if (video_file) {
+        fclose(video_file);
+        video_file = NULL;
+    }
+    put_le(size, 36 + 2 * audio_samples, 4);
+    fseek(audio_file, 4, SEEK_SET);
+    fwrite(size, 1, 4, audio_file);
+    put_le(size, 2 * audio_samples, 4);
+    fseek(audio_file, 40, SEEK_SET);
+    fwrite(size, 1, 4, audio_file);
+    fclose(audio_file);
+    audio_file = NULL;
+
+    printf("Recorder: %llu frames written to %s, %llu dropped (queue full)\n", (unsigned long long)frames_written,
+           record_name, (unsigned long long)frames_dropped);
+    for (int i = 0; i < 10; i++) {
+        free(sample_data[i]);
+    }
+    free(record_queue);
+    record_queue = NULL;
+    record_format = RECORD_OFF;
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sample_profiler.h"
+
+#ifndef _WIN32
+
+#include <signal.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include <sys/time.h>
+
+// Ring buffer filled by the SIGPROF handler and emptied by the execution loop on the same thread
+sample_record sample_ring[SAMPLE_RING_SIZE];
+volatile sig_atomic_t sample_head = 0;        // Written by the signal handler only
+volatile sig_atomic_t sample_tail = 0;        // Written by the execution loop only
+volatile sig_atomic_t sample_dropped = 0;
+volatile sig_atomic_t current_phase = PHASE_OTHER;
+
+arcade_system *sampled_system = NULL;
+FILE *sample_file = NULL;
+uint32_t sample_interval = 0;                 // µs
+uint64_t sample_count = 0;
+
+const char *phase_names[] = {"other", "input", "cpu", "draw", "present", "sleep"};
+
+/**
+ * SIGPROF handler: record the guest PC, the emulator phase and the host stack.
+ * Only async-signal-safe work is done here, the samples are written to the file by flush_samples().
+*/
+void take_sample(int signal) {
+    void *stack[SAMPLE_STACK_DEPTH + 2];
+    int head = sample_head;
+    int next = (head + 1) % SAMPLE_RING_SIZE;
+    sample_record *sample = &sample_ring[head];
+    int depth = 0;
+
+    (void)signal;
+    if (next == sample_tail) {
+        sample_dropped++;  // The execution loop did not flush for too long
+        return;
+    }
+    depth = backtrace(stack, SAMPLE_STACK_DEPTH + 2) - 2;  // Skip the handler and the signal trampoline
+    for (int i = 0; i < depth; i++) {
+        sample->host[i] = (uintptr_t)stack[i + 2];
+    }
+    sample->depth = depth > 0 ? depth : 0;
+    sample->frame = sampled_system->frame_count;
+    sample->pc = sampled_system->state.pc;
+    sample->phase = current_phase;
+    sample_head = next;
+}
+
+/**
+ * Open the sample file and install the handler. SIGPROF is blocked for the threads created afterwards
+ * (e.g. the SDL audio thread) so all samples are taken on the emulation thread, see start_sample_profiler().
+*/
+void initialize_sample_profiler(arcade_system *system) {
+    struct sigaction action;
+    sigset_t set;
+    uint32_t header[3];
+    void *prime[1];
+
+    if (system->sample_profile == 0) {
+        return;
+    }
+    sample_file = fopen(SAMPLE_FILE, "wb");
+    if (!sample_file) {
+        printf("Could not create the %s file!\n", SAMPLE_FILE);
+        exit(1);
+    }
+    sampled_system = system;
+    sample_interval = system->sample_profile * 1000;
+    header[0] = 1;
+    header[1] = sample_interval;
+    header[2] = SAMPLE_STACK_DEPTH;
+    fwrite("I8SP", 1, 4, sample_file);
+    fwrite(header, sizeof(uint32_t), 3, sample_file);
+
+    backtrace(prime, 1);  // The first backtrace() call loads libgcc, which must not happen in the signal handler
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = take_sample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+/**
+ * Unblock SIGPROF on the emulation thread and start the profiling timer
+*/
+void start_sample_profiler(void) {
+    struct itimerval timer;
+    sigset_t set;
+
+    if (!sample_file) {
+        return;
+    }
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+    timer.it_interval.tv_sec = sample_interval / 1000000;
+    timer.it_interval.tv_usec = sample_interval % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+    printf("Sampling profiler: one sample every %u ms\n", sample_interval / 1000);
+}
+
+void set_emulator_phase(emulator_phase phase) {
+    current_phase = phase;
+}
+
+/**
+ * Append the buffered samples to the sample file. Called once per video frame.
+*/
+void flush_samples(void) {
+    int head = sample_head;
+
+    if (!sample_file) {
+        return;
+    }
+    while (sample_tail != head) {
+        sample_record *sample = &sample_ring[sample_tail];
+
+        fwrite(sample, offsetof(sample_record, host), 1, sample_file);
+        fwrite(sample->host, sizeof(uint64_t), sample->depth, sample_file);
+        sample_count++;
+        sample_tail = (sample_tail + 1) % SAMPLE_RING_SIZE;
+    }
+}
+
+typedef struct {
+    char *stack;
+    uint32_t count;
+} folded_stack;
+
+typedef struct {
+    uint64_t address;
+    char *name;
+} host_symbol;
+
+int host_symbol_count = 0;
+
+uint32_t hash_string(const char *string) {
+    uint32_t hash = 2166136261u;
+
+    while (*string) {
+        hash = (hash ^ (uint8_t)*string++) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Function name of a host code address, e.g. "exec_opcode" (the Makefile links with -rdynamic). Static functions
+ * and binaries linked without it get the offset in the binary instead of the absolute address, e.g. "invaders+0x1a2b",
+ * which does not change with the load address.
+*/
+char *host_symbol_name(host_symbol *symbols, uint64_t address) {
+    uint32_t slot = (uint32_t)(address * 2654435761u) % MAX_HOST_SYMBOLS;
+    char **text = NULL;
+    char *name = NULL, *start = NULL, *end = NULL, *binary = NULL;
+    void *pointer = (void *)(uintptr_t)address;
+
+    while (symbols[slot].name && symbols[slot].address != address) {
+        slot = (slot + 1) % MAX_HOST_SYMBOLS;
+    }
+    if (symbols[slot].name) {
+        return symbols[slot].name;
+    }
+    if (host_symbol_count == MAX_HOST_SYMBOLS - 1) {
+        return "?";  // Table full
+    }
+    host_symbol_count++;
+
+    // backtrace_symbols() format: "binary(function+0x12) [0x5566]"
+    text = backtrace_symbols(&pointer, 1);
+    start = text ? strchr(text[0], '(') : NULL;
+    end = start ? strchr(start, ')') : NULL;
+    name = malloc(128);
+    if (!name) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    if (start && end && start[1] != '+' && start[1] != ')') {
+        snprintf(name, 128, "%.*s", (int)strcspn(start + 1, "+)"), start + 1);
+    } else if (start && end && start[1] == '+') {
+        *start = 0;
+        binary = strrchr(text[0], '/');
+        snprintf(name, 128, "%s%.*s", binary ? binary + 1 : text[0], (int)(end - start - 1), start + 1);
+    } else {
+        snprintf(name, 128, "0x%llx", (unsigned long long)address);
+    }
+    free(text);
+
+    symbols[slot].address = address;
+    symbols[slot].name = name;
+    return name;
+}
+
+/**
+ * Read the sample file back and count identical stacks: "phase;host frames (outer to inner);guest PC count"
+*/
+void write_folded_stacks(void) {
+    static folded_stack stacks[MAX_FOLDED_STACKS];
+    static host_symbol symbols[MAX_HOST_SYMBOLS];
+    sample_record sample;
+    char line[SAMPLE_STACK_DEPTH * 128 + 64];
+    char magic[4];
+    uint32_t header[3];
+    uint32_t slot = 0;
+    int unique = 0, length = 0;
+    FILE *file = fopen(SAMPLE_FILE, "rb");
+    FILE *folded = fopen(FOLDED_FILE, "w");
+
+    if (!file || !folded || fread(magic, 1, 4, file) != 4 || fread(header, sizeof(uint32_t), 3, file) != 3) {
+        printf("Could not write the %s file!\n", FOLDED_FILE);
+        return;
+    }
+    while (fread(&sample, offsetof(sample_record, host), 1, file) == 1
+           && fread(sample.host, sizeof(uint64_t), sample.depth, file) == sample.depth) {
+        length = snprintf(line, sizeof(line), "%s", phase_names[sample.phase]);
+        for (int i = sample.depth - 1; i >= 0; i--) {
+            length += snprintf(line + length, sizeof(line) - length, ";%s", host_symbol_name(symbols, sample.host[i]));
+        }
+        if (sample.phase == PHASE_CPU) {
+            snprintf(line + length, sizeof(line) - length, ";guest_%04X", sample.pc);
+        }
+
+        slot = hash_string(line) % MAX_FOLDED_STACKS;
+        while (stacks[slot].stack && strcmp(stacks[slot].stack, line) != 0) {
+            slot = (slot + 1) % MAX_FOLDED_STACKS;
+        }
+        if (!stacks[slot].stack) {
+            if (unique == MAX_FOLDED_STACKS - 1) {
+                continue;  // Table full, the stack is dropped from the export (it stays in the sample file)
+            }
+            stacks[slot].stack = strdup(line);
+            unique++;
+        }
+        stacks[slot].count++;
+    }
+    for (int i = 0; i < MAX_FOLDED_STACKS; i++) {
+        if (stacks[i].stack) {
+            fprintf(folded, "%s %u\n", stacks[i].stack, stacks[i].count);
+        }
+    }
+    fclose(file);
+    fclose(folded);
+    printf("Sampling profiler: %d different stacks written to %s\n", unique, FOLDED_FILE);
+}
+
+/**
+ * Stop the timer, write the remaining samples and export the folded stacks
+*/
+void report_sample_profiler(void) {
+    struct itimerval timer;
+
+    if (!sample_file) {
+        return;
+    }
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    flush_samples();
+    fclose(sample_file);
+    sample_file = NULL;
+    printf("Sampling profiler: %llu samples written to %s, %d dropped\n", (unsigned long long)sample_count,
+        SAMPLE_FILE, (int)sample_dropped);
+    write_folded_stacks();
+}
+
+#else
+
+// No SIGPROF / setitimer on Windows
+
+void initialize_sample_profiler(arcade_system *system) {
+    if (system->sample_profile) {
+        printf("The sampling profiler is not supported on this platform\n");
+    }
+}
+
+void start_sample_profiler(void) {}
+void set_emulator_phase(emulator_phase phase) { (void)phase; }
+void flush_samples(void) {}
+void report_sample_profiler(void) {}
+
+#endif
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/**
+ * Reset the master cycle counter and remove all events
+*/
+void initialize_scheduler(scheduler *sched) {
+    sched->cycles = 0;
+    sched->idle = NULL;
+    sched->hook_entry = NULL;
+    sched->hook = NULL;
+    sched->hook_device = NULL;
+    sched->count = 0;
+}
+
+/**
+ * Add an event to the queue. Events with the same deadline are executed in the order they have been scheduled.
+*/
+void schedule_event(scheduler *sched, uint64_t deadline, event_handler handler, void *device) {
+    int i = sched->count;
+
+    if (sched->count >= MAX_TIMED_EVENTS) {
+        printf("Too many timed events!\n");
+        exit(-1);
+    }
+
+    while (i > 0 && sched->events[i - 1].deadline > deadline) {
+        sched->events[i] = sched->events[i - 1];
+        i--;
+    }
+    sched->events[i].deadline = deadline;
+    sched->events[i].handler = handler;
+    sched->events[i].device = device;
+    sched->count++;
+}
+
+/**
+ * Run the CPU in one burst up to the deadline of the next event and execute the event handler.
+ * With idle loop detection a backward jump (or HLT) may fast-forward the CPU to the deadline.
+ * An entry hook (e.g. high level emulation) is called before executing the marked ROM addresses.
+*/
+void run_next_event(scheduler *sched, Cpu_state *state) {
+    timed_event event = sched->events[0];
+    uint64_t cycles = sched->cycles;
+    uint16_t pc = 0;
+
+    if (sched->idle || sched->hook_entry) {
+        while (cycles < event.deadline) {
+            pc = state->pc;
+            if (sched->hook_entry && pc < 0x2000 && sched->hook_entry[pc]) {
+                cycles = sched->hook(sched->hook_device, state, cycles, event.deadline);
+                if (cycles >= event.deadline) {
+                    break;
+                }
+                pc = state->pc;
+            }
+            cycles += exec_opcode(state);
+            if (sched->idle && state->pc <= pc) {
+                cycles = skip_idle_loop(sched->idle, state, pc, cycles, event.deadline);
+            }
+        }
+    } else {
+        while (cycles < event.deadline) {
+            cycles += exec_opcode(state);
+        }
+    }
+    sched->cycles = cycles;
+
+    sched->count--;
+    for (int i = 0; i < sched->count; i++) {
+        sched->events[i] = sched->events[i + 1];
+    }
+    event.handler(event.device);
+}
@@ -1,7 +1,98 @@
 #include <stdio.h>
 #include "sdl_input.h"
+#include "i8080_ports.h"
+#include "latency.h"
+#include "latency_probe.h"
 
 SDL_GameController *controller[2] = {NULL, NULL};
+latency_histogram input_latency;  // SDL input event until the game reads the changed port bit
+
+// Input bits that are visible on the input ports 0, 1 and 2
+const uint8_t port_input_mask[3] = {
+    INPUT_SHOT | INPUT_LEFT | INPUT_RIGHT,
+    INPUT_COIN | INPUT_START2 | INPUT_START1 | INPUT_SHOT | INPUT_LEFT | INPUT_RIGHT,
+    INPUT_TILT | INPUT_SHOT | INPUT_LEFT | INPUT_RIGHT
+};
+
+/**
+ * Reset the input word and the latency measurement
+*/
+void initialize_input(arcade_system *system) {
+    system->input = 0;
+    system->input_pending = 0;
+    for (int i = 0; i < 8; i++) {
+        system->input_stamp[i] = 0;
+    }
+    initialize_latency_histogram(&input_latency, "Input event to port read");
+    initialize_latency_probe();
+}
+
+/**
+ * Set or clear an input bit and its input port bits. With the latency histogram active the SDL event time stamp
+ * is kept until the game reads the changed bit.
+*/
+void set_input(arcade_system *system, uint8_t bit, int state, uint32_t timestamp) {
+    uint8_t previous = system->input;
+
+    if (state) {
+        system->input |= bit;
+    } else {
+        system->input &= ~bit;
+    }
+    update_input_ports(system, bit, state);
+
+    if (system->input != previous && system->input_mode[1]) {
+        for (int i = 0; i < 8; i++) {
+            if (bit == (1 << i)) {
+                system->input_stamp[i] = timestamp;
+            }
+        }
+        system->input_pending |= bit;
+    }
+
+    if (system->input != previous && state && system->input_mode[2]) {
+        probe_input_event(system, bit, timestamp);  // Input-to-photon latency measurement
+    }
+}
+
+/**
+ * Called by read_port() while input changes are pending.
+ * Records the latency of every changed bit that is visible on the read port.
+*/
+void input_port_read(arcade_system *system, uint8_t port_number) {
+    uint8_t seen = 0;
+    uint32_t now = 0;
+
+    if (port_number > 2) {
+        return;
+    }
+
+    seen = system->input_pending & port_input_mask[port_number];
+    if (seen) {
+        now = SDL_GetTicks();
+        for (int i = 0; i < 8 && system->input_mode[1]; i++) {
+            if (seen & (1 << i)) {
+                record_latency(&input_latency, (now - system->input_stamp[i]) * 1000);
+            }
+        }
+        if (system->input_mode[2]) {
+            probe_port_read(system, seen);
+        }
+        system->input_pending &= ~seen;
+    }
+}
+
+/**
+ * Print the input latency histogram and the input-to-photon measurement
+*/
+void report_input_latency(arcade_system *system) {
+    if (system->input_mode[1]) {
+        print_latency_histogram(&input_latency);
+    }
+    if (system->input_mode[2]) {
+        report_latency_probe();
+    }
+}
 
 /**
  * Search for connected gamepads
@@ -26,25 +117,25 @@ void keyHandler(SDL_KeyboardEvent *event, arcade_system *system, int state) {
     if (event->repeat == 0) {
         switch (event->keysym.scancode) {
             case SDL_SCANCODE_LEFT:
-                system->left = state;
+                set_input(system, INPUT_LEFT, state, event->timestamp);
                 break;
             case SDL_SCANCODE_RIGHT:
-                system->right = state;
+                set_input(system, INPUT_RIGHT, state, event->timestamp);
                 break;
             case SDL_SCANCODE_SPACE:
-                system->shot = state;
+                set_input(system, INPUT_SHOT, state, event->timestamp);
                 break;
             case SDL_SCANCODE_1:
-                system->start1 = state;
+                set_input(system, INPUT_START1, state, event->timestamp);
                 break;
             case SDL_SCANCODE_2:
-                system->start2 = state;
+                set_input(system, INPUT_START2, state, event->timestamp);
                 break;
             case SDL_SCANCODE_C:
-                system->coin = state;
+                set_input(system, INPUT_COIN, state, event->timestamp);
                 break;
             case SDL_SCANCODE_T:
-                system->tilt = state;
+                set_input(system, INPUT_TILT, state, event->timestamp);
                 break;
             case SDL_SCANCODE_ESCAPE:
                 system->quit = state;
@@ -62,28 +153,28 @@ void keyHandler(SDL_KeyboardEvent *event, arcade_system *system, int state) {
 void gamepadHandler(SDL_Event event, arcade_system *system, int state) {
     switch (event.cbutton.button) {
         case SDL_CONTROLLER_BUTTON_START:
-            system->coin = state;
+            set_input(system, INPUT_COIN, state, event.cbutton.timestamp);
             break;
         case SDL_CONTROLLER_BUTTON_BACK:
             system->quit = state;
         break;
         case SDL_CONTROLLER_BUTTON_Y:
-            system->start1 = state;
+            set_input(system, INPUT_START1, state, event.cbutton.timestamp);
             break;
         case SDL_CONTROLLER_BUTTON_B:
-            system->start2 = state;
+            set_input(system, INPUT_START2, state, event.cbutton.timestamp);
             break;
         case SDL_CONTROLLER_BUTTON_X:
-            system->shot = state;
+            set_input(system, INPUT_SHOT, state, event.cbutton.timestamp);
             break;
         case SDL_CONTROLLER_BUTTON_A:
-            system->shot = state;
+            set_input(system, INPUT_SHOT, state, event.cbutton.timestamp);
         break;
         case SDL_CONTROLLER_BUTTON_DPAD_LEFT:
-            system->left = state;
+            set_input(system, INPUT_LEFT, state, event.cbutton.timestamp);
             break;
         case SDL_CONTROLLER_BUTTON_DPAD_RIGHT:
-            system->right = state;
+            set_input(system, INPUT_RIGHT, state, event.cbutton.timestamp);
             break;
         default:
             break;
@@ -4,6 +4,8 @@
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_image.h>
 #include "sdl_video.h"
+#include "sample_profiler.h"
+#include "frame_export.h"
 
 SDL_Texture *background_texture;
 SDL_Texture *game_texture;
@@ -93,31 +95,13 @@ void initialize_video(arcade_system *system) {
  * Any coloring and rotation happens on the render textures.
 */
 void draw_frame(arcade_system *system) {
-    uint8_t byte = 0;
-    uint16_t i = 0;
-    uint32_t color = 0;
-    uint32_t pitch = 0;
     SDL_Rect dstrect;
     int flip = SDL_FLIP_NONE;
     int angle = 0;
    
-    // Scan the Space Invaders memory sequentially and map the CRT line drawing on the display game_texture.
-    // This results in a 90° clockwise rotated image because the monitor in the arcade cabinet is rotated by 90° counter clockwise. 
-    for(int y=0; y < GAME_HEIGHT; y++) {
-        pitch = y * GAME_WIDTH;
-        for(int x=0; x < GAME_WIDTH; x=x+8)  {
-            byte = system->state.memory[i + 0x2400];
-            i++;
-            
-            for(int bit = 0; bit < 8; bit++) {
-                if ((byte >> bit) & 0x01) { 
-                    color = 0xFFFFFFFF;
-                } else {
-                    color = 0x00000000;
-                }
-                pixels[pitch + x + bit] = color;
-            }
-        }
+    convert_frame(system->state.ram, pixels);  // Video RAM to the pixels of the game texture
+    if (system->frame_export) {
+        publish_frame(system, pixels);          // Shared memory for capture processes, never waits for them
     }
 
     if (system->cocktail_vertical_screen_flip && system->arcade_mode[5]) {
@@ -158,5 +142,6 @@ void draw_frame(arcade_system *system) {
     }
     SDL_RenderCopyEx(renderer, target_texture, NULL, &dstrect, angle, NULL, flip);    
    
+    set_emulator_phase(PHASE_PRESENT);
     SDL_RenderPresent(renderer);
 }
\ No newline at end of file
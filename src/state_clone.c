@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state_clone.h"
+
+uint64_t store_serial = 0;  // Last serial number given to a clone store
+
+/**
+ * Empty store, the pages and clones are allocated on demand
+*/
+void create_clone_store(clone_store *store) {
+    memset(store, 0, sizeof(clone_store));
+    store->serial = __atomic_add_fetch(&store_serial, 1, __ATOMIC_RELAXED);
+    store->next_id = 1;
+}
+
+/**
+ * Allocate a block of CLONE_CHUNK elements, the block is freed with the store
+*/
+void *allocate_chunk(clone_store *store, size_t size) {
+    void *chunk = aligned_alloc(64, CLONE_CHUNK * size);
+    void **chunks = realloc(store->chunks, (store->chunk_count + 1) * sizeof(void *));
+
+    if (!chunk || !chunks) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    store->chunks = chunks;
+    store->chunks[store->chunk_count++] = chunk;
+    return chunk;
+}
+
+/**
+ * Take a free page, the page gets a new content id
+*/
+ram_page *allocate_page(clone_store *store) {
+    ram_page *page = NULL;
+
+    if (!store->free_pages) {
+        page = allocate_chunk(store, sizeof(ram_page));
+        for (int i = 0; i < CLONE_CHUNK; i++) {
+            page[i].id = 0;
+            page[i].next_free = i + 1 < CLONE_CHUNK ? &page[i + 1] : NULL;
+        }
+        store->free_pages = page;
+    }
+    page = store->free_pages;
+    store->free_pages = page->next_free;
+    page->id = store->next_id++;
+    page->references = 1;
+    return page;
+}
+
+state_clone *allocate_clone(clone_store *store) {
+    state_clone *clone = NULL;
+
+    if (!store->free_clones) {
+        clone = allocate_chunk(store, sizeof(state_clone));
+        for (int i = 0; i < CLONE_CHUNK; i++) {
+            clone[i].next_free = i + 1 < CLONE_CHUNK ? &clone[i + 1] : NULL;
+        }
+        store->free_clones = clone;
+    }
+    clone = store->free_clones;
+    store->free_clones = clone->next_free;
+    return clone;
+}
+
+/**
+ * RAM pages of an instance that still hold the content of their clone pages
+*/
+uint32_t clean_pages(clone_store *store, arcade_system *system) {
+    return system->clone_source.store == store->serial ? ~system->state.dirty_pages : 0;
+}
+
+/**
+ * Clone a running instance. The RAM pages not written since the last clone or restore of the instance are shared
+ * with the clones taken before, only the written pages with a new content are copied.
+*/
+state_clone *clone_instance(clone_store *store, arcade_system *system) {
+    state_clone *clone = allocate_clone(store);
+    clone_source *source = &system->clone_source;
+    uint32_t clean = clean_pages(store, system), known = source->store == store->serial ? ~0u : 0;
+    Cpu_state *state = &system->state;
+
+    for (int i = 0; i < RAM_PAGES; i++) {
+        ram_page *page = source->pages[i];
+
+        // Written pages often get the same content again (e.g. redrawn sprites)
+        if (known >> i & 1 && page->id == source->ids[i]
+            && (clean >> i & 1 || memcmp(page->data, &state->ram[i * RAM_PAGE_SIZE], RAM_PAGE_SIZE) == 0)) {
+            page->references++;
+            store->pages_shared++;
+        } else {
+            page = allocate_page(store);
+            memcpy(page->data, &state->ram[i * RAM_PAGE_SIZE], RAM_PAGE_SIZE);
+            source->pages[i] = page;
+            source->ids[i] = page->id;
+            store->pages_copied++;
+        }
+        clone->pages[i] = page;
+    }
+    source->store = store->serial;
+    state->dirty_pages = 0;
+
+    memcpy(clone->regs, state->regs, sizeof(clone->regs));
+    clone->sp = state->sp;
+    clone->pc = state->pc;
+    clone->cc = state->cc;
+    clone->int_enable = state->int_enable;
+    clone->halted = state->halted;
+    clone->ext_shift_data = system->ext_shift_data;
+    clone->ext_shift_offset = system->ext_shift_offset;
+    clone->sound_latch[0] = system->sound_latch[0];
+    clone->sound_latch[1] = system->sound_latch[1];
+    clone->cocktail_vertical_screen_flip = system->cocktail_vertical_screen_flip;
+    clone->input = system->input;
+    memcpy(clone->input_port, system->input_port, sizeof(clone->input_port));
+    clone->input_pending = system->input_pending;
+    clone->frame_count = system->frame_count;
+    clone->origin = system;
+    clone->scheduler = system->scheduler;
+    return clone;
+}
+
+/**
+ * Continue an instance of the same ROM set from a clone. Only the RAM pages that differ from the clone are copied.
+*/
+void restore_clone(clone_store *store, arcade_system *system, const state_clone *clone) {
+    clone_source *source = &system->clone_source;
+    uint32_t clean = clean_pages(store, system);
+    Cpu_state *state = &system->state;
+
+    for (int i = 0; i < RAM_PAGES; i++) {
+        ram_page *page = clone->pages[i];
+
+        if (!(clean >> i & 1) || source->pages[i] != page || source->ids[i] != page->id) {
+            memcpy(&state->ram[i * RAM_PAGE_SIZE], page->data, RAM_PAGE_SIZE);
+            source->pages[i] = page;
+            source->ids[i] = page->id;
+            store->pages_copied++;
+        }
+    }
+    source->store = store->serial;
+    state->dirty_pages = 0;
+
+    memcpy(state->regs, clone->regs, sizeof(state->regs));
+    state->sp = clone->sp;
+    state->pc = clone->pc;
+    state->cc = clone->cc;
+    state->int_enable = clone->int_enable;
+    state->halted = clone->halted;
+    system->ext_shift_data = clone->ext_shift_data;
+    system->ext_shift_offset = clone->ext_shift_offset;
+    system->sound_latch[0] = clone->sound_latch[0];
+    system->sound_latch[1] = clone->sound_latch[1];
+    system->cocktail_vertical_screen_flip = clone->cocktail_vertical_screen_flip;
+    system->input = clone->input;
+    memcpy(system->input_port, clone->input_port, sizeof(system->input_port));
+    system->input_pending = clone->input_pending;
+    system->frame_count = clone->frame_count;
+    adopt_scheduler(system, &clone->scheduler, clone->origin);
+}
+
+/**
+ * Drop a clone, its pages are recycled when no other clone holds them
+*/
+void release_clone(clone_store *store, state_clone *clone) {
+    for (int i = 0; i < RAM_PAGES; i++) {
+        ram_page *page = clone->pages[i];
+
+        if (--page->references == 0) {
+            page->id = 0;
+            page->next_free = store->free_pages;
+            store->free_pages = page;
+        }
+    }
+    clone->next_free = store->free_clones;
+    store->free_clones = clone;
+}
+
+/**
+ * Free all pages and clones. The instances cloned or restored with the store copy all pages the next time.
+*/
+void destroy_clone_store(clone_store *store) {
+    for (int i = 0; i < store->chunk_count; i++) {
+        free(store->chunks[i]);
+    }
+    free(store->chunks);
+    memset(store, 0, sizeof(clone_store));
+}
@@ -0,0 +1,33 @@
+#include <string.h>
+#include "state_hash.h"
+#include "video_frame.h"
+
+/**
+ * Fast non-cryptographic 64 bit hash, 8 bytes per step (about 1µs for the whole RAM).
+ * Only used to detect differences between two emulation runs.
+*/
+uint64_t hash_memory(const uint8_t *data, size_t size) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+    uint64_t word = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        memcpy(&word, &data[i], 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x94D049BB133111EBULL;
+    }
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * Hash the video RAM and the work RAM separately
+*/
+void hash_frame(arcade_system *system, frame_hash *hash) {
+    hash->video = hash_memory(&system->state.ram[VIDEO_RAM - RAM_START], VIDEO_RAM_SIZE);
+    hash->work = hash_memory(&system->state.ram[WORK_RAM - RAM_START], WORK_RAM_SIZE);
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+/**
+ * Run the indices of the own range, then steal the remaining indices of the other ranges
+*/
+void run_ranges(thread_pool *pool, int id) {
+    int index = 0, owner = 0;
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        owner = (id + i) % pool->thread_count;
+        while ((index = atomic_fetch_add(&pool->ranges[owner].next, 1)) < pool->ranges[owner].end) {
+            pool->task(pool->context, index);
+        }
+    }
+}
+
+/**
+ * Worker thread: wait for a batch, take part in it and report when done
+*/
+void *pool_thread(void *arg) {
+    pool_worker *worker = arg;
+    thread_pool *pool = worker->pool;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->quit && pool->generation == generation) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_ranges(pool, worker->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Start the worker threads, 0 threads = one per CPU core
+*/
+void create_thread_pool(thread_pool *pool, int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (thread_count > MAX_POOL_THREADS) {
+        thread_count = MAX_POOL_THREADS;
+    }
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    pool->thread_count = thread_count;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Thread 0 is the caller of run_thread_pool()
+    for (int i = 1; i < thread_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, pool_thread, &pool->workers[i]) != 0) {
+            printf("Could not start the pool thread %d!\n", i);
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Run the task for the indices 0 ... count - 1 and return when all are done.
+ * Each thread starts with an equal share of the indices and steals from the others when it runs out of work.
+*/
+void run_thread_pool(thread_pool *pool, int count, pool_task task, void *context) {
+    int share = count / pool->thread_count, rest = count % pool->thread_count, start = 0;
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        atomic_store(&pool->ranges[i].next, start);
+        start += share + (i < rest);
+        pool->ranges[i].end = start;
+    }
+    pool->task = task;
+    pool->context = context;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy = pool->thread_count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_ranges(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Stop and join the worker threads
+*/
+void destroy_thread_pool(thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+}
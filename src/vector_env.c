@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vector_env.h"
+#include "config_rom_loader.h"
+#include "i8080_ports.h"
+#include "video_frame.h"
+
+/**
+ * Cache line aligned allocation
+*/
+void *allocate_aligned(size_t size) {
+    void *memory = aligned_alloc(64, (size + 63) & ~(size_t)63);
+
+    if (!memory) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    return memory;
+}
+
+/**
+ * Copy the video RAM of an instance to its observation slot and decode its game variables
+*/
+void copy_observation(vector_env *env, int index) {
+    memcpy(&env->observations[(size_t)index * OBSERVATION_SIZE], &env->instances[index].state.ram[VIDEO_RAM - RAM_START], OBSERVATION_SIZE);
+    if (env->ram_map) {
+        read_game_state(env->instances[index].state.ram, env->ram_map, &env->game_states[index]);
+    }
+    if (env->frame_stacks) {
+        push_observation(&env->frame_stacks[index], env->instances[index].state.ram, &env->spec);
+    }
+}
+
+/**
+ * Pool task: reset one instance to the power-up state of the template
+*/
+void reset_instance(void *context, int index) {
+    vector_env *env = context;
+
+    reset_pool_instance(&env->slots, &env->instances[index]);
+    if (env->frame_stacks) {
+        reset_frame_stack(&env->frame_stacks[index], NULL);  // A new episode starts with blank frames
+    }
+    copy_observation(env, index);
+}
+
+/**
+ * Pool task: emulate one frame of an instance with its input word
+*/
+void step_instance(void *context, int index) {
+    vector_env *env = context;
+    arcade_system *system = &env->instances[index];
+
+    if (system->input != env->inputs[index]) {
+        set_input_word(system, env->inputs[index]);
+    }
+    emulate_frame(system);
+    copy_observation(env, index);
+}
+
+/**
+ * Create the instances of a ROM set configuration (invaders.ini format), the ROM files are loaded once.
+ * 0 threads = one per CPU core.
+*/
+vector_env *create_vector_env(char *filename, int count, int thread_count) {
+    vector_env *env = calloc(1, sizeof(vector_env));
+
+    if (!env) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    env->count = count;
+    env->template = allocate_aligned(sizeof(arcade_system));
+    env->observations = allocate_aligned((size_t)count * OBSERVATION_SIZE);
+    env->game_states = allocate_aligned(count * sizeof(game_state));
+
+    initialize_arcade_machine(env->template);
+    load_config_file(env->template, filename);
+    start_arcade_machine(env->template);
+    env->ram_map = find_game_ram_map(env->template);
+
+    create_instance_pool(&env->slots, env->template, count, POOL_HUGE_PAGES);
+    for (int i = 0; i < count; i++) {
+        acquire_instance(&env->slots);
+    }
+    env->instances = pool_instance(&env->slots, 0);
+
+    create_thread_pool(&env->pool, thread_count);
+    reset_vector_env(env, -1);
+    return env;
+}
+
+/**
+ * Reset one instance (e.g. at the end of an episode) or all instances (index -1) to the power-up state
+*/
+void reset_vector_env(vector_env *env, int index) {
+    if (index < 0) {
+        run_thread_pool(&env->pool, env->count, reset_instance, env);
+    } else if (index < env->count) {
+        reset_instance(env, index);
+    }
+}
+
+/**
+ * Emulate one frame of all instances, each with its own input word. The observations are updated in place.
+*/
+void step_vector_env(vector_env *env, const uint8_t *inputs) {
+    env->inputs = inputs;
+    run_thread_pool(&env->pool, env->count, step_instance, env);
+}
+
+/**
+ * Also keep the last depth observations of each instance downsampled by the spec (e.g. 84 x 84 max pooled, depth 4)
+ * in frame_stacks. stacked_frames() gives them as one block, oldest first.
+*/
+void enable_vector_preprocessing(vector_env *env, const observation_spec *spec, int depth) {
+    env->spec = *spec;
+    env->frame_stacks = allocate_aligned(env->count * sizeof(frame_stack));
+    for (int i = 0; i < env->count; i++) {
+        create_frame_stack(&env->frame_stacks[i], depth, spec->out_width * spec->out_height);
+        push_observation(&env->frame_stacks[i], env->instances[i].state.ram, spec);
+    }
+}
+
+/**
+ * Leave the observations and game states in buffers of the caller (count entries each), e.g. in shared memory.
+ * The buffers are not freed by destroy_vector_env().
+*/
+void attach_vector_buffers(vector_env *env, uint8_t *observations, game_state *game_states) {
+    if (!env->external_buffers) {
+        free(env->observations);
+        free(env->game_states);
+    }
+    env->observations = observations;
+    env->game_states = game_states;
+    env->external_buffers = 1;
+    for (int i = 0; i < env->count; i++) {
+        memcpy(&env->observations[(size_t)i * OBSERVATION_SIZE], &env->instances[i].state.ram[VIDEO_RAM - RAM_START], OBSERVATION_SIZE);
+        if (env->ram_map) {
+            read_game_state(env->instances[i].state.ram, env->ram_map, &env->game_states[i]);
+        }
+    }
+}
+
+/**
+ * Stop the worker threads and free the instances
+*/
+void destroy_vector_env(vector_env *env) {
+    destroy_thread_pool(&env->pool);
+    if (!env->external_buffers) {
+        free(env->observations);
+        free(env->game_states);
+    }
+    for (int i = 0; env->frame_stacks && i < env->count; i++) {
+        destroy_frame_stack(&env->frame_stacks[i]);
+    }
+    free(env->frame_stacks);
+    destroy_instance_pool(&env->slots);
+    release_arcade_machine(env->template);
+    free(env->template);
+    free(env);
+}
@@ -0,0 +1,22 @@
+#include "video_frame.h"
+
+/**
+ * Convert the game video RAM (1 bit per pixel) to 32 bit pixels (white / transparent black) in original orientation.
+ * This results in a 90° clockwise rotated image because the monitor in the arcade cabinet is rotated by 90° counter clockwise.
+*/
+void convert_frame(const uint8_t *ram, uint32_t *pixels) {
+    const uint8_t *video_ram = &ram[VIDEO_RAM - RAM_START];
+    uint8_t byte = 0;
+    uint32_t pitch = 0;
+
+    // Scan the Space Invaders memory sequentially and map the CRT line drawing on the pixel buffer
+    for (int y = 0; y < GAME_HEIGHT; y++) {
+        pitch = y * GAME_WIDTH;
+        for (int x = 0; x < GAME_WIDTH; x = x + 8) {
+            byte = *video_ram++;
+            for (int bit = 0; bit < 8; bit++) {
+                pixels[pitch + x + bit] = ((byte >> bit) & 0x01) ? 0xFFFFFFFF : 0x00000000;
+            }
+        }
+    }
+}
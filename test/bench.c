@@ -0,0 +1,135 @@
+// ****************************************************************************************
+// * Headless whole-game benchmark
+// * Runs each given ROM set configuration (invaders.ini format) without SDL through an
+// * input trace for a fixed number of frames and reports the frame throughput as well as
+// * the time split between the CPU emulation and the video frame conversion.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "arcade.h"
+#include "config_rom_loader.h"
+#include "video_frame.h"
+#include "input_trace.h"
+#include "test_timer.h"
+#include "rom_check.h"
+
+#define DEFAULT_FRAMES 18000  // About 5 minutes of game time
+#define RUNS 3                // The fastest run is reported
+
+typedef struct {
+    double cpu;               // Seconds spent in emulate_frame()
+    double video;             // Seconds spent in convert_frame()
+    uint64_t cycles;
+} bench_result;
+
+input_trace trace;  // Empty without -t
+
+/**
+ * Emulate the frames from reset with the input trace applied at the start of each frame
+*/
+void run_benchmark(arcade_system *system, char *filename, uint64_t frames, bench_result *result) {
+    static uint32_t pixels[GAME_WIDTH * GAME_HEIGHT];
+    double start = 0, cpu_end = 0;
+
+    initialize_arcade_machine(system);
+    load_config_file(system, filename);
+    start_arcade_machine(system);
+    rewind_trace(&trace);
+
+    result->cpu = 0;
+    result->video = 0;
+    while (system->frame_count < frames) {
+        apply_trace(&trace, system);
+        start = time_in_seconds();
+        emulate_frame(system);
+        cpu_end = time_in_seconds();
+        convert_frame(system->state.ram, pixels);
+        result->video += time_in_seconds() - cpu_end;
+        result->cpu += cpu_end - start;
+    }
+    result->cycles = system->scheduler.cycles;
+    release_arcade_machine(system);
+}
+
+/**
+ * Benchmark one ROM set in a child process, the console output of the ROM loading is suppressed. ROM sets with
+ * missing ROM files are skipped, a child ending without a result (e.g. an emulation error) fails the benchmark.
+ * Returns 0 on a failure.
+*/
+int benchmark_rom_set(char *filename, uint64_t frames) {
+    static arcade_system system;
+    bench_result result, best;
+    pid_t pid = 0;
+    int status = 0, out = 0;
+    double total = 0;
+
+    if (!rom_set_readable(filename)) {
+        printf("%s\tskipped (ROM files missing or unreadable)\n", filename);
+        return 1;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        printf("%s\tFAIL (could not start the benchmark process)\n", filename);
+        return 0;
+    }
+    if (pid == 0) {
+        out = dup(STDOUT_FILENO);
+        if (!freopen("/dev/null", "w", stdout)) {
+            exit(1);
+        }
+        best.cpu = 1e9;
+        best.video = 0;
+        best.cycles = 1;
+        for (int run = 0; run < RUNS; run++) {
+            run_benchmark(&system, filename, frames, &result);
+            if (result.cpu + result.video < best.cpu + best.video) {
+                best = result;
+            }
+        }
+        total = best.cpu + best.video;
+        dprintf(out, "%s\t%llu\t%.1f\t%.3f\t%.3f\t%.3f\t%.1f\t%.1f\n", filename, (unsigned long long)frames,
+            frames / total, best.cpu * 1e9 / best.cycles, best.cpu * 1e3 / frames, best.video * 1e3 / frames,
+            100.0 * best.cpu / total, 100.0 * best.video / total);
+        exit(0);
+    }
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) {
+        printf("%s\tFAIL (emulation ended by signal %d)\n", filename, WTERMSIG(status));
+        return 0;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("%s\tFAIL (emulation ended the process, exit status %d)\n", filename, WEXITSTATUS(status));
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Usage: bench [-f frames] [-t input trace] <ini files>
+*/
+int main(int argc, char *argv[]) {
+    uint64_t frames = DEFAULT_FRAMES;
+    int option = 0, failed = 0;
+
+    while ((option = getopt(argc, argv, "f:t:")) != -1) {
+        if (option == 'f') {
+            frames = strtoull(optarg, NULL, 10);
+        } else if (option == 't') {
+            load_trace(&trace, optarg);
+        } else {
+            printf("Usage: bench [-f frames] [-t input trace] <ini files>\n");
+            return 1;
+        }
+    }
+
+    printf("# rom_set\tframes\tframes_per_second\tns_per_cycle\tcpu_ms_per_frame\tvideo_ms_per_frame\tcpu_percent\tvideo_percent\n");
+    for (int i = optind; i < argc; i++) {
+        failed += !benchmark_rom_set(argv[i], frames);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+// ****************************************************************************************
+// * Copy-on-write clone benchmark
+// * Grows a search tree of machine states: each branch continues a random node for a few
+// * frames with a random input word and adds the result as a new node. The nodes are kept
+// * as copy-on-write clones and, on a reference instance, as full snapshots. Prints the ns
+// * per restore and clone for both and the share of the RAM pages shared. The clones must
+// * give exactly the same states as the snapshots.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "state_clone.h"
+#include "config_rom_loader.h"
+#include "i8080_ports.h"
+#include "test_timer.h"
+#include "rom_check.h"
+
+#define DEFAULT_BRANCHES 20000
+#define DEFAULT_STEPS 1      // Frames per branch
+#define MAX_NODES 1024       // Then the nodes are replaced round robin
+#define WARMUP_FRAMES 200    // Coin and start before the tree is grown
+
+arcade_snapshot nodes[MAX_NODES];  // Reference nodes
+state_clone *clones[MAX_NODES];
+uint32_t random_state = 12345;
+
+uint32_t random_number(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+/**
+ * Machine state of the instance and the reference, returns 1 if they are the same
+*/
+int same_machine(arcade_system *a, arcade_system *b) {
+    return memcmp(a->state.regs, b->state.regs, sizeof(a->state.regs)) == 0 && a->state.sp == b->state.sp
+           && a->state.pc == b->state.pc && memcmp(&a->state.cc, &b->state.cc, sizeof(a->state.cc)) == 0
+           && a->state.int_enable == b->state.int_enable && memcmp(a->state.ram, b->state.ram, RAM_SIZE) == 0
+           && a->ext_shift_data == b->ext_shift_data && a->ext_shift_offset == b->ext_shift_offset
+           && a->scheduler.cycles == b->scheduler.cycles && a->frame_count == b->frame_count;
+}
+
+/**
+ * Usage: clone_bench [-b branches] [-k frames per branch] <ini file>
+*/
+int main(int argc, char *argv[]) {
+    static arcade_system template, system, reference;
+    clone_store store;
+    int branches = DEFAULT_BRANCHES, steps = DEFAULT_STEPS, option = 0, count = 1, failed = 0;
+    double clone_time = 0, snapshot_time = 0, start = 0;
+
+    while ((option = getopt(argc, argv, "b:k:")) != -1) {
+        if (option == 'b') {
+            branches = atoi(optarg);
+        } else if (option == 'k') {
+            steps = atoi(optarg);
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || branches < 1 || steps < 1) {
+        printf("Usage: clone_bench [-b branches] [-k frames per branch] <ini file>\n");
+        return 1;
+    }
+
+    if (!rom_set_readable(argv[optind])) {
+        printf("%s\tskipped (ROM files missing or unreadable)\n", argv[optind]);
+        return 0;
+    }
+
+    initialize_arcade_machine(&template);
+    load_config_file(&template, argv[optind]);
+    start_arcade_machine(&template);
+    copy_arcade_machine(&system, &template);
+    for (int frame = 0; frame < WARMUP_FRAMES; frame++) {
+        set_input_word(&system, frame >= 120 && frame < 130 ? INPUT_COIN : frame >= 180 && frame < 190 ? INPUT_START1 : 0);
+        emulate_frame(&system);
+    }
+    copy_arcade_machine(&reference, &system);
+    create_clone_store(&store);
+    clones[0] = clone_instance(&store, &system);
+    save_arcade_state(&reference, &nodes[0]);
+
+    for (int branch = 0; branch < branches && !failed; branch++) {
+        int parent = random_number() % count, child = count < MAX_NODES ? count : 1 + branch % (MAX_NODES - 1);
+        uint8_t input = random_number() & (INPUT_LEFT | INPUT_RIGHT | INPUT_SHOT);
+
+        if (child == count) {
+            count++;
+        } else {
+            parent = parent == child ? 0 : parent;  // The root stays
+            release_clone(&store, clones[child]);
+        }
+        start = time_in_seconds();
+        restore_clone(&store, &system, clones[parent]);
+        clone_time += time_in_seconds() - start;
+        start = time_in_seconds();
+        load_arcade_state(&reference, &nodes[parent]);
+        snapshot_time += time_in_seconds() - start;
+
+        set_input_word(&system, input);
+        set_input_word(&reference, input);
+        for (int frame = 0; frame < steps; frame++) {
+            emulate_frame(&system);
+            emulate_frame(&reference);
+        }
+        failed = !same_machine(&system, &reference);
+
+        start = time_in_seconds();
+        clones[child] = clone_instance(&store, &system);
+        clone_time += time_in_seconds() - start;
+        start = time_in_seconds();
+        save_arcade_state(&reference, &nodes[child]);
+        snapshot_time += time_in_seconds() - start;
+    }
+
+    printf("# method\tns_per_branch\n");
+    printf("clone\t%.0f\n", clone_time * 1e9 / branches);
+    printf("snapshot\t%.0f\n", snapshot_time * 1e9 / branches);
+    printf("# %.1f%% of the cloned RAM pages shared, %.1f pages copied per branch\n",
+        100.0 * store.pages_shared / ((double)(branches + 1) * RAM_PAGES), (double)store.pages_copied / branches);
+    printf("Clones: %s\n", failed ? "DIFFERENT" : "ok");
+
+    destroy_clone_store(&store);
+    release_arcade_machine(&template);
+    return failed ? 1 : 0;
+}
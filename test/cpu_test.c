@@ -0,0 +1,198 @@
+// ****************************************************************************************
+// * Intel 8080 CPU test runner
+// * Runs CP/M CPU test programs (e.g. TST8080.COM, CPUDIAG.COM, 8080PRE.COM, 8080EXM.COM)
+// * on the emulator core with a minimal CP/M BDOS (console output functions 2 and 9).
+// * Without arguments a built-in smoke test is executed.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i8080.h"
+#include "test_timer.h"
+
+#define PROGRAM_ADDRESS 0x100       // CP/M transient program area
+#define BDOS_ADDRESS 0x0005         // CALL 5 is the CP/M system call
+#define STACK_TOP 0x3F00            // Top of the program area read from address 6 by some tests
+#define MAX_CYCLES 100000000000ULL  // 8080EXM needs about 23 billion cycles
+#define OUTPUT_SIZE 65536
+
+// Built-in smoke test: console output, a 16 x 65536 DCX loop for the throughput and a BCD addition
+const uint8_t smoke_test[] = {
+    0x31, 0x00, 0x3F,        // 0100 LXI SP,3F00
+    0x11, 0x80, 0x01,        // 0103 LXI D,0180      title
+    0x0E, 0x09,              // 0106 MVI C,9
+    0xCD, 0x05, 0x00,        // 0108 CALL 5
+    0x26, 0x10,              // 010B MVI H,10
+    0x01, 0x00, 0x00,        // 010D LXI B,0000
+    0x0B,                    // 0110 DCX B
+    0x78,                    // 0111 MOV A,B
+    0xB1,                    // 0112 ORA C
+    0xC2, 0x10, 0x01,        // 0113 JNZ 0110
+    0x25,                    // 0116 DCR H
+    0xC2, 0x0D, 0x01,        // 0117 JNZ 010D
+    0x3E, 0x35,              // 011A MVI A,35
+    0xC6, 0x47,              // 011C ADI 47
+    0x27,                    // 011E DAA             35 + 47 = 82 (BCD)
+    0xFE, 0x82,              // 011F CPI 82
+    0x11, 0x40, 0x01,        // 0121 LXI D,0140      passed
+    0xCA, 0x2A, 0x01,        // 0124 JZ 012A
+    0x11, 0x60, 0x01,        // 0127 LXI D,0160      failed
+    0x0E, 0x09,              // 012A MVI C,9
+    0xCD, 0x05, 0x00,        // 012C CALL 5
+    0x0E, 0x02,              // 012F MVI C,2
+    0x1E, 0x0A,              // 0131 MVI E,0A
+    0xCD, 0x05, 0x00,        // 0133 CALL 5
+    0xC3, 0x00, 0x00,        // 0136 JMP 0           warm boot ends the test
+};
+
+typedef struct {
+    char *name;
+    uint64_t cycles;
+    double seconds;
+    int passed;
+} test_result;
+
+char output[OUTPUT_SIZE];
+int output_length = 0;
+
+/**
+ * Console output of the test program, echoed and kept for the pass / fail check
+*/
+void console_output(char c) {
+    putchar(c);
+    if (output_length < OUTPUT_SIZE - 1) {
+        output[output_length++] = c;
+        output[output_length] = 0;
+    }
+}
+
+/**
+ * Minimal CP/M BDOS: function 2 prints the character in E, function 9 the '$' terminated string at DE.
+ * Afterwards the call returns to the program.
+*/
+void bdos_call(Cpu_state *state) {
+    uint16_t address = (state->regs[D] << 8) | state->regs[E];
+
+    if (state->regs[C] == 2) {
+        console_output(state->regs[E]);
+    } else if (state->regs[C] == 9) {
+        while (read_memory(state, address) != '$') {
+            console_output(read_memory(state, address++));
+        }
+    }
+    state->pc = read_memory(state, state->sp) | (read_memory(state, state->sp + 1) << 8);
+    state->sp += 2;
+}
+
+/**
+ * Copy data into the emulated memory (ROM and RAM area)
+*/
+void copy_to_memory(Cpu_state *state, uint16_t address, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        write_memory(state, address + i, data[i]);
+    }
+}
+
+/**
+ * Empty machine: all memory writable, BDOS entry and warm boot vector in place, all I/O ports unmapped
+*/
+void reset_machine(Cpu_state *state, io_bus *bus) {
+    static uint8_t low_memory[ROM_SIZE];  // Writable memory in place of the ROM
+
+    memset(state, 0, sizeof(Cpu_state));
+    memset(low_memory, 0, sizeof(low_memory));
+    initialize_io_bus(bus);
+    state->bus = bus;
+    state->rom = low_memory;
+    state->rom_end = 0;
+    state->pc = PROGRAM_ADDRESS;
+    write_memory(state, BDOS_ADDRESS, 0xC3);              // JMP to the top of the program area
+    write_memory(state, BDOS_ADDRESS + 1, STACK_TOP & 0xff);
+    write_memory(state, BDOS_ADDRESS + 2, STACK_TOP >> 8);
+    write_memory(state, STACK_TOP, 0xC9);                 // Never reached, the BDOS is emulated
+    output_length = 0;
+    output[0] = 0;
+}
+
+/**
+ * Load a CP/M .COM file to the program area
+*/
+int load_program(Cpu_state *state, char *filename) {
+    static uint8_t program[STACK_TOP - PROGRAM_ADDRESS];
+    FILE *file = fopen(filename, "rb");
+    size_t size = 0;
+
+    if (!file) {
+        printf("Could not open %s!\n", filename);
+        return 0;
+    }
+    size = fread(program, 1, sizeof(program), file);
+    fclose(file);
+    copy_to_memory(state, PROGRAM_ADDRESS, program, size);
+    return size > 0;
+}
+
+/**
+ * Run the loaded program until it jumps to the warm boot address 0.
+ * The tests print "CPU IS OPERATIONAL" or "complete" when passed and "ERROR" or "FAILED" otherwise.
+*/
+void run_program(Cpu_state *state, test_result *result) {
+    double start = time_in_seconds();
+
+    result->cycles = 0;
+    while (state->pc != 0 && result->cycles < MAX_CYCLES) {
+        if (state->pc == BDOS_ADDRESS) {
+            bdos_call(state);
+        } else {
+            result->cycles += exec_opcode(state);
+        }
+    }
+    result->seconds = time_in_seconds() - start;
+    result->passed = state->pc == 0 && !strstr(output, "ERROR") && !strstr(output, "FAILED")
+                     && (strstr(output, "OPERATIONAL") || strstr(output, "complete"));
+    printf("\n");
+}
+
+/**
+ * Usage: cpu_test [test program .COM files]
+*/
+int main(int argc, char *argv[]) {
+    static Cpu_state state;
+    static test_result results[64];
+    io_bus bus;
+    int count = 0, failed = 0;
+
+    if (argc < 2) {
+        reset_machine(&state, &bus);
+        copy_to_memory(&state, PROGRAM_ADDRESS, smoke_test, sizeof(smoke_test));
+        copy_to_memory(&state, 0x140, (const uint8_t *)"CPU IS OPERATIONAL$", 19);
+        copy_to_memory(&state, 0x160, (const uint8_t *)"CPU HAS FAILED!$", 16);
+        copy_to_memory(&state, 0x180, (const uint8_t *)"8080 smoke test: $", 18);
+        results[0].name = "built-in";
+        run_program(&state, &results[0]);
+        count = 1;
+    }
+    for (int i = 1; i < argc && count < 64; i++) {
+        reset_machine(&state, &bus);
+        results[count].name = argv[i];
+        if (load_program(&state, argv[i])) {
+            printf("%s\n", argv[i]);
+            run_program(&state, &results[count]);
+        } else {
+            results[count].passed = 0;
+            results[count].cycles = 0;
+            results[count].seconds = 0;
+        }
+        count++;
+    }
+
+    printf("Test                     Result         Cycles     Time   Emulated\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-24s %-6s %14llu %7.2fs %7.1f MHz\n", results[i].name, results[i].passed ? "PASS" : "FAIL",
+            (unsigned long long)results[i].cycles, results[i].seconds,
+            results[i].seconds > 0 ? results[i].cycles / results[i].seconds / 1e6 : 0.0);
+        failed += !results[i].passed;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+// ****************************************************************************************
+// * Frame export test
+// * Publishes frames and sound events into the shared memory rings as fast as possible
+// * while a reader thread copies the newest frames: every accepted frame must be complete
+// * (all pixels from the same frame) and the frame numbers must never go backwards. A
+// * reader falling behind the sound event ring must get the newest events in order.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "frame_export.h"
+
+#define FRAMES 20000
+#define SOUND_EVENTS 3000
+
+arcade_system system_state;
+uint32_t pixels[GAME_WIDTH * GAME_HEIGHT];
+export_frame copy;
+volatile int writing = 1;
+int torn = 0, backwards = 0, accepted = 0;
+
+void *reader_thread(void *argument) {
+    const frame_export_header *header = argument;
+    int64_t number = 0, last = -1;
+
+    while (writing) {
+        number = read_export_frame(header, &copy);
+        if (number < 0) {
+            continue;
+        }
+        for (int i = 0; i < GAME_WIDTH * GAME_HEIGHT; i++) {
+            if (copy.pixels[i] != (uint32_t)copy.frame_count) {
+                torn++;
+                break;
+            }
+        }
+        backwards += number < last || copy.frame_count != (uint64_t)number;
+        last = number;
+        accepted++;
+    }
+    return NULL;
+}
+
+int main(void) {
+    const frame_export_header *header = NULL;
+    sound_event events[SOUND_EVENT_SLOTS];
+    uint64_t position = 0;
+    pthread_t thread;
+    size_t size = 0;
+    int count = 0, failed = 0;
+
+    memset(&system_state, 0, sizeof(system_state));
+    system_state.frame_export = 4;
+    initialize_frame_export(&system_state);
+    header = attach_frame_export(frame_export_name(), &size);
+    if (!header) {
+        printf("Cannot attach to %s\n", frame_export_name());
+        return 1;
+    }
+
+    pthread_create(&thread, NULL, reader_thread, (void *)header);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        system_state.frame_count = frame;
+        for (int i = 0; i < GAME_WIDTH * GAME_HEIGHT; i++) {
+            pixels[i] = frame;
+        }
+        publish_frame(&system_state, pixels);
+    }
+    writing = 0;
+    pthread_join(thread, NULL);
+    failed += torn || backwards || !accepted;
+    printf("Frames: %d of %d read, %d torn, %d out of order: %s\n", accepted, FRAMES, torn, backwards, failed ? "FAILED" : "passed");
+
+    for (int i = 0; i < SOUND_EVENTS; i++) {
+        system_state.sound_latch[i & 1] = (i - 2) & 0xFF;
+        export_sound_event(&system_state, i & 1 ? 5 : 3, i & 0xFF);
+    }
+    count = read_sound_events(header, &position, events, SOUND_EVENT_SLOTS);
+    for (int i = 0; i < count; i++) {
+        uint64_t number = SOUND_EVENTS - count + i;
+
+        failed += events[i].data != (number & 0xFF) || events[i].port != (number & 1 ? 5 : 3)
+                  || events[i].previous != ((number - 2) & 0xFF);
+    }
+    failed += count < SOUND_EVENT_SLOTS - 1 || position != SOUND_EVENTS;
+    failed += read_sound_events(header, &position, events, SOUND_EVENT_SLOTS) != 0;
+    printf("Sound events: newest %d of %d read: %s\n", count, SOUND_EVENTS, failed ? "FAILED" : "passed");
+
+    munmap((void *)header, size);
+    close_frame_export();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+// ****************************************************************************************
+// * Game state test
+// * Writes known game variables into a RAM image at the addresses of the Midway ROM set
+// * and compares each field decoded by read_game_state(): BCD scores and credits, the
+// * current player selected by 0x2067, the ships and invader table of that player's data
+// * block and the shot, player and UFO bytes.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "game_state.h"
+
+uint8_t ram[RAM_SIZE];
+int failed = 0;
+
+void poke(uint16_t address, uint8_t value) {
+    ram[address - RAM_START] = value;
+}
+
+void expect(const char *field, uint64_t value, uint64_t expected) {
+    if (value != expected) {
+        printf("    %s: 0x%llx, expected 0x%llx\n", field, (unsigned long long)value, (unsigned long long)expected);
+        failed++;
+    }
+}
+
+/**
+ * Both player data blocks hold a full invader table, the dead invaders of the current player are cleared
+*/
+void fill_player_blocks(const int *dead, int dead_count) {
+    for (int i = 0; i < INVADER_COUNT; i++) {
+        poke(0x2100 + i, 1);
+        poke(0x2200 + i, 1);
+    }
+    for (int i = 0; i < dead_count; i++) {
+        poke(0x2200 + dead[i], 0);
+    }
+    poke(0x21FF, 1);  // Ships of player 1
+    poke(0x22FF, 3);  // Ships of player 2
+}
+
+int test_player_2(void) {
+    const int dead[] = {0, 10, 27, 54};
+    game_state game;
+    int before = failed;
+
+    memset(ram, 0, sizeof(ram));
+    poke(0x20F8, 0x50);  // Score player 1: 1250
+    poke(0x20F9, 0x12);
+    poke(0x20FA, 0x99);  // Score player 2: 9999
+    poke(0x20FB, 0x99);
+    poke(0x20F4, 0x05);  // High score: 1905
+    poke(0x20F5, 0x19);
+    poke(0x20EB, 0x23);  // Credits (BCD)
+    poke(0x2067, 0x22);  // Player 2 data block
+    poke(0x2082, 51);
+    poke(0x20EF, 1);
+    poke(0x2015, 0xFF);
+    poke(0x201B, 0x48);
+    poke(0x2025, 1);
+    poke(0x2029, 0x60);
+    poke(0x202A, 0x4A);
+    poke(0x2035, 2);
+    poke(0x205E, 0x7C);
+    poke(0x2084, 1);
+    poke(0x2088, 0x90);
+    fill_player_blocks(dead, 4);
+
+    read_game_state(ram, &invaders_ram_map, &game);
+    expect("score[0]", game.score[0], 1250);
+    expect("score[1]", game.score[1], 9999);
+    expect("high_score", game.high_score, 1905);
+    expect("credits", game.credits, 23);
+    expect("player", game.player, 2);
+    expect("ships", game.ships, 3);
+    expect("invaders", game.invaders, ((1ULL << INVADER_COUNT) - 1) & ~(1ULL << 0 | 1ULL << 10 | 1ULL << 27 | 1ULL << 54));
+    expect("invader_count", game.invader_count, 51);
+    expect("game_running", game.game_running, 1);
+    expect("player_alive", game.player_alive, 0xFF);
+    expect("player_x", game.player_x, 0x48);
+    expect("player_shot[0]", game.player_shot[0], 1);
+    expect("player_shot[1]", game.player_shot[1], 0x60);
+    expect("player_shot[2]", game.player_shot[2], 0x4A);
+    expect("invader_shot[0][0]", game.invader_shot[0][0], 2);
+    expect("invader_shot[2][2]", game.invader_shot[2][2], 0x7C);
+    expect("ufo_active", game.ufo_active, 1);
+    expect("ufo_x", game.ufo_x, 0x90);
+    printf("Player 2 game: %s\n", failed > before ? "FAILED" : "passed");
+    return failed > before;
+}
+
+int test_player_1(void) {
+    const int dead[] = {3};
+    game_state game;
+    int before = failed;
+
+    // Player 1 (0x21) and the uninitialized RAM (0) of the power-up both select the block at 0x2100
+    for (int selector = 0; selector < 2; selector++) {
+        memset(ram, 0, sizeof(ram));
+        poke(0x2067, selector ? 0x21 : 0x00);
+        fill_player_blocks(dead, 1);
+        read_game_state(ram, &invaders_ram_map, &game);
+        expect("player", game.player, 1);
+        expect("ships", game.ships, 1);
+        expect("invaders", game.invaders, (1ULL << INVADER_COUNT) - 1);
+        expect("score[0]", game.score[0], 0);
+    }
+    printf("Player 1 game: %s\n", failed > before ? "FAILED" : "passed");
+    return failed > before;
+}
+
+int main(void) {
+    test_player_2();
+    test_player_1();
+    return failed ? 1 : 0;
+}
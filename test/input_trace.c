@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "input_trace.h"
+#include "i8080_ports.h"
+
+/**
+ * Load an input trace: "<frame> <input word (hex)>" per line, # starts a comment
+*/
+void load_trace(input_trace *trace, char *filename) {
+    char buffer[256];
+    unsigned long long frame = 0;
+    unsigned int input = 0;
+    FILE *file = fopen(filename, "r");
+
+    if (!file) {
+        printf("Could not open the input trace %s!\n", filename);
+        exit(1);
+    }
+    trace->count = 0;
+    while (fgets(buffer, sizeof(buffer), file) && trace->count < MAX_TRACE_EVENTS) {
+        if (buffer[0] != '#' && sscanf(buffer, "%llu %x", &frame, &input) == 2) {
+            trace->events[trace->count].frame = frame;
+            trace->events[trace->count].input = input;
+            trace->count++;
+        }
+    }
+    fclose(file);
+    rewind_trace(trace);
+}
+
+/**
+ * Start again with the first event (e.g. for the next run from reset)
+*/
+void rewind_trace(input_trace *trace) {
+    trace->next = 0;
+}
+
+/**
+ * Set the input word of all events due at the start of the next frame
+*/
+void apply_trace(input_trace *trace, arcade_system *system) {
+    while (trace->next < trace->count && trace->events[trace->next].frame <= system->frame_count) {
+        set_input_word(system, trace->events[trace->next].input);
+        trace->next++;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <stdint.h>
+#include "arcade.h"
+
+#define MAX_TRACE_EVENTS 4096
+
+typedef struct {
+    uint64_t frame;
+    uint8_t input;
+} trace_event;
+
+// Input trace: the input word is set at the start of the given frame and kept until the next event
+typedef struct {
+    trace_event events[MAX_TRACE_EVENTS];
+    int count;
+    int next;                 // Next event to apply
+} input_trace;
+
+// Input trace API (headless test programs)
+void load_trace(input_trace *trace, char *filename);
+void rewind_trace(input_trace *trace);
+void apply_trace(input_trace *trace, arcade_system *system);
+
+#endif
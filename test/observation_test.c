@@ -0,0 +1,134 @@
+// ****************************************************************************************
+// * Observation kernel test
+// * Downsamples random and sparse video RAM contents with several crop rectangles and
+// * observation sizes and compares the result with a straightforward implementation on
+// * the 32 bit frame of convert_frame(). Then the frame stack order is checked and the
+// * ns per 84 x 84 observation are printed.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "observation.h"
+#include "video_frame.h"
+#include "test_timer.h"
+
+#define TIMING_FRAMES 20000
+
+const observation_spec specs[] = {
+    {0, 0, UPRIGHT_WIDTH, UPRIGHT_HEIGHT, 84, 84, OBSERVATION_MAX},
+    {0, 0, UPRIGHT_WIDTH, UPRIGHT_HEIGHT, 84, 84, OBSERVATION_MEAN},
+    {0, 32, UPRIGHT_WIDTH, 208, 112, 104, OBSERVATION_MAX},   // Without the score and the ships line
+    {0, 32, UPRIGHT_WIDTH, 208, 112, 104, OBSERVATION_MEAN},
+    {0, 0, UPRIGHT_WIDTH, UPRIGHT_HEIGHT, UPRIGHT_WIDTH, UPRIGHT_HEIGHT, OBSERVATION_MAX},  // Upright 1:1
+    {5, 3, 201, 250, 67, 29, OBSERVATION_MEAN},
+};
+
+uint8_t ram[RAM_SIZE];
+uint32_t pixels[GAME_WIDTH * GAME_HEIGHT];
+uint8_t expected[UPRIGHT_WIDTH * UPRIGHT_HEIGHT];
+uint8_t result[UPRIGHT_WIDTH * UPRIGHT_HEIGHT];
+uint32_t random_state = 42;
+
+uint8_t random_byte(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+/**
+ * Reference: rotate the converted frame upright and pool the boxes pixel by pixel
+*/
+void reference_observation(const observation_spec *spec, uint8_t *out) {
+    convert_frame(ram, pixels);
+    for (int row = 0; row < spec->out_height; row++) {
+        int top = spec->y + row * spec->height / spec->out_height;
+        int bottom = spec->y + (row + 1) * spec->height / spec->out_height;
+
+        for (int column = 0; column < spec->out_width; column++) {
+            int left = spec->x + column * spec->width / spec->out_width;
+            int right = spec->x + (column + 1) * spec->width / spec->out_width;
+            int count = 0;
+
+            for (int y = top; y < bottom; y++) {
+                for (int x = left; x < right; x++) {
+                    count += pixels[x * GAME_WIDTH + GAME_WIDTH - 1 - y] != 0;  // 90° counter clockwise
+                }
+            }
+            *out++ = spec->pooling == OBSERVATION_MAX ? (count ? 255 : 0) : count * 255 / ((right - left) * (bottom - top));
+        }
+    }
+}
+
+int test_kernels(void) {
+    int failed = 0;
+
+    for (int content = 0; content < 4; content++) {
+        for (int i = 0; i < RAM_SIZE; i++) {
+            ram[i] = content == 0 ? random_byte() : content == 1 ? (random_byte() & random_byte() & random_byte()) : 0;
+        }
+        if (content == 3) {
+            ram[VIDEO_RAM - RAM_START + 100 * 32 + 17] = 0x10;  // A single pixel
+        }
+        for (size_t s = 0; s < sizeof(specs) / sizeof(specs[0]); s++) {
+            const observation_spec *spec = &specs[s];
+            int size = spec->out_width * spec->out_height;
+
+            reference_observation(spec, expected);
+            downsample_frame(ram, spec, result);
+            if (memcmp(expected, result, size) != 0) {
+                printf("Observation %dx%d (pooling %d, content %d) differs\n", spec->out_width, spec->out_height, spec->pooling, content);
+                failed++;
+            }
+        }
+    }
+    printf("Kernels: %s\n", failed ? "FAILED" : "passed");
+    return failed;
+}
+
+int test_frame_stack(void) {
+    frame_stack stack;
+    uint8_t frame[3];
+    const uint8_t *frames = NULL;
+    int failed = 0;
+
+    create_frame_stack(&stack, 4, sizeof(frame));
+    memset(frame, 0xAA, sizeof(frame));
+    reset_frame_stack(&stack, frame);
+    for (int n = 1; n <= 10; n++) {
+        memset(frame, n, sizeof(frame));
+        push_frame(&stack, frame);
+        frames = stacked_frames(&stack);
+        for (int i = 0; i < 4; i++) {
+            int want = n - 3 + i >= 1 ? n - 3 + i : 0xAA;  // Oldest first
+
+            failed += frames[i * sizeof(frame)] != want || frames[i * sizeof(frame) + 2] != want;
+        }
+    }
+    destroy_frame_stack(&stack);
+    printf("Frame stack: %s\n", failed ? "FAILED" : "passed");
+    return failed;
+}
+
+void time_kernels(void) {
+    double start = 0;
+
+    for (int i = 0; i < RAM_SIZE; i++) {
+        ram[i] = random_byte() & random_byte();
+    }
+    for (int s = 0; s < 2; s++) {
+        start = time_in_seconds();
+        for (int i = 0; i < TIMING_FRAMES; i++) {
+            downsample_frame(ram, &specs[s], result);
+        }
+        printf("84x84 %s: %.0f ns per frame\n", s ? "mean" : "max pooling", (time_in_seconds() - start) * 1e9 / TIMING_FRAMES);
+    }
+}
+
+int main(void) {
+    int failed = 0;
+
+    failed += test_kernels();
+    failed += test_frame_stack();
+    time_kernels();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+// ****************************************************************************************
+// * Intel 8080 opcode micro-benchmark
+// * Runs synthetic instruction streams of one instruction class through exec_opcode()
+// * and prints the host nanoseconds per instruction as a tab separated table.
+// * With a previous table as argument the change against that baseline is printed.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i8080.h"
+#include "test_timer.h"
+
+#define CODE_START 0x0100
+#define CODE_END 0x2F00             // The stream is closed by a JMP back to the start
+#define DATA_ADDRESS 0x3000         // HL, BC and DE point to RAM
+#define SUBROUTINE_ADDRESS 0x3E00   // RET for the CALL / RET stream
+#define STACK_TOP 0x3F00
+#define WARMUP_INSTRUCTIONS 1000000
+#define RUN_INSTRUCTIONS 10000000
+#define RUNS 7                      // The fastest run is reported
+#define MAX_BASELINE 64
+
+// Instruction class: the listed instructions are repeated until the code area is full
+typedef struct {
+    char *name;
+    int length;                     // Bytes per instruction
+    int count;
+    uint8_t code[16][3];
+    int jump_next;                  // Address bytes point to the following instruction (conditional jumps)
+} instruction_class;
+
+const instruction_class classes[] = {
+    {"nop",      1, 1, {{0x00}}, 0},
+    {"mov_r_r",  1, 8, {{0x41}, {0x4A}, {0x53}, {0x5C}, {0x78}, {0x47}, {0x7B}, {0x5F}}, 0},
+    {"mov_r_m",  1, 5, {{0x46}, {0x4E}, {0x56}, {0x5E}, {0x7E}}, 0},
+    {"mov_m_r",  1, 5, {{0x70}, {0x71}, {0x72}, {0x73}, {0x77}}, 0},
+    {"mvi",      2, 4, {{0x06, 0x12}, {0x0E, 0x34}, {0x16, 0x56}, {0x3E, 0x78}}, 0},
+    {"alu_r",    1, 8, {{0x80}, {0x89}, {0x92}, {0x9B}, {0xA0}, {0xA9}, {0xB2}, {0xBB}}, 0},
+    {"alu_m",    1, 8, {{0x86}, {0x8E}, {0x96}, {0x9E}, {0xA6}, {0xAE}, {0xB6}, {0xBE}}, 0},
+    {"alu_imm",  2, 8, {{0xC6, 0x11}, {0xCE, 0x22}, {0xD6, 0x33}, {0xDE, 0x44},
+                        {0xE6, 0xF5}, {0xEE, 0x66}, {0xF6, 0x01}, {0xFE, 0x88}}, 0},
+    {"inr_dcr",  1, 8, {{0x04}, {0x0D}, {0x14}, {0x1D}, {0x3C}, {0x05}, {0x0C}, {0x3D}}, 0},
+    {"inx_dcx",  1, 4, {{0x03}, {0x1B}, {0x13}, {0x0B}}, 0},
+    {"dad",      1, 3, {{0x09}, {0x19}, {0x39}}, 0},
+    {"push_pop", 1, 8, {{0xC5}, {0xC1}, {0xD5}, {0xD1}, {0xE5}, {0xE1}, {0xF5}, {0xF1}}, 0},
+    {"call_ret", 3, 1, {{0xCD, SUBROUTINE_ADDRESS & 0xff, SUBROUTINE_ADDRESS >> 8}}, 0},
+    {"jcc",      3, 8, {{0xC2}, {0xCA}, {0xD2}, {0xDA}, {0xE2}, {0xEA}, {0xF2}, {0xFA}}, 1},
+    {"in_out",   2, 4, {{0xDB, 0x01}, {0xD3, 0x02}, {0xDB, 0x02}, {0xD3, 0x04}}, 0},
+    {"lda_sta",  3, 4, {{0x3A, 0x00, 0x30}, {0x32, 0x01, 0x30}, {0x2A, 0x02, 0x30}, {0x22, 0x04, 0x30}}, 0},
+    {"rotate",   1, 8, {{0x07}, {0x0F}, {0x17}, {0x1F}, {0x2F}, {0x37}, {0x3F}, {0x27}}, 0},
+};
+
+typedef struct {
+    char name[64];
+    double ns;
+} baseline_entry;
+
+/**
+ * Empty machine with the instruction stream of one class in the code area
+*/
+void prepare_stream(Cpu_state *state, io_bus *bus, const instruction_class *class) {
+    static uint8_t low_memory[ROM_SIZE];  // Writable memory in place of the ROM
+    uint16_t address = CODE_START;
+
+    memset(state, 0, sizeof(Cpu_state));
+    memset(low_memory, 0, sizeof(low_memory));
+    initialize_io_bus(bus);
+    state->bus = bus;
+    state->rom = low_memory;
+    state->rom_end = 0;
+    state->pc = CODE_START;
+    state->sp = STACK_TOP;
+    state->regs[B] = state->regs[D] = state->regs[H] = DATA_ADDRESS >> 8;
+    state->regs[C] = 0x10;
+    state->regs[E] = 0x20;
+
+    // Only whole groups, e.g. each PUSH is followed by its POP
+    while (address + class->length * class->count <= CODE_END - 3) {
+        for (int i = 0; i < class->count; i++) {
+            for (int j = 0; j < class->length; j++) {
+                write_memory(state, address + j, class->code[i][j]);
+            }
+            if (class->jump_next) {
+                write_memory(state, address + 1, (address + 3) & 0xff);
+                write_memory(state, address + 2, (address + 3) >> 8);
+            }
+            address += class->length;
+        }
+    }
+    write_memory(state, address, 0xC3);  // JMP CODE_START
+    write_memory(state, address + 1, CODE_START & 0xff);
+    write_memory(state, address + 2, CODE_START >> 8);
+    write_memory(state, SUBROUTINE_ADDRESS, 0xC9);
+}
+
+/**
+ * Read a previous result table: "name <tab> ns ..." lines, # starts a comment
+*/
+int load_baseline(char *filename, baseline_entry *baseline) {
+    char buffer[256];
+    int count = 0;
+    FILE *file = fopen(filename, "r");
+
+    if (!file) {
+        printf("Could not open the baseline %s!\n", filename);
+        exit(1);
+    }
+    while (fgets(buffer, sizeof(buffer), file) && count < MAX_BASELINE) {
+        if (buffer[0] != '#' && sscanf(buffer, "%63s %lf", baseline[count].name, &baseline[count].ns) == 2) {
+            count++;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+/**
+ * Usage: opcode_bench [baseline table]
+*/
+int main(int argc, char *argv[]) {
+    static Cpu_state state;
+    static baseline_entry baseline[MAX_BASELINE];
+    io_bus bus;
+    int baseline_count = 0;
+    uint64_t cycles = 0;
+    double start = 0, elapsed = 0, best = 0;
+
+    if (argc > 1) {
+        baseline_count = load_baseline(argv[1], baseline);
+    }
+
+    printf("# class\tns_per_instruction\tcycles_per_instruction\temulated_mhz%s\n",
+        baseline_count ? "\tbaseline_ns\tchange_percent" : "");
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        prepare_stream(&state, &bus, &classes[i]);
+        for (int j = 0; j < WARMUP_INSTRUCTIONS; j++) {
+            exec_opcode(&state);
+        }
+
+        best = 1e9;
+        for (int run = 0; run < RUNS; run++) {
+            cycles = 0;
+            start = time_in_seconds();
+            for (int j = 0; j < RUN_INSTRUCTIONS; j++) {
+                cycles += exec_opcode(&state);
+            }
+            elapsed = time_in_seconds() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        printf("%s\t%.3f\t%.2f\t%.1f", classes[i].name, best * 1e9 / RUN_INSTRUCTIONS,
+            (double)cycles / RUN_INSTRUCTIONS, cycles / best / 1e6);
+        for (int j = 0; j < baseline_count; j++) {
+            if (strcmp(baseline[j].name, classes[i].name) == 0) {
+                printf("\t%.3f\t%+.1f", baseline[j].ns, 100.0 * (best * 1e9 / RUN_INSTRUCTIONS - baseline[j].ns) / baseline[j].ns);
+            }
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+// ****************************************************************************************
+// * Instance pool benchmark
+// * Spins instances of one ROM set up and down: acquire / release from the instance pool
+// * against malloc / copy / free, and reset in place. Prints the ns per create and destroy
+// * cycle and the pages backing the arena. A recycled or reset instance must run exactly
+// * like a fresh copy of the template.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "instance_pool.h"
+#include "config_rom_loader.h"
+#include "state_hash.h"
+#include "test_timer.h"
+#include "rom_check.h"
+
+#define DEFAULT_CYCLES 100000
+#define LIVE_INSTANCES 64  // Instances alive at the same time, recycled round robin
+
+const char *page_names[] = {"small pages", "huge pages (MAP_HUGETLB)", "transparent huge pages"};
+
+/**
+ * RAM hash after one frame of a fresh copy of the template
+*/
+uint64_t fresh_hash(arcade_system *template) {
+    static arcade_system system;
+
+    copy_arcade_machine(&system, template);
+    emulate_frame(&system);
+    return hash_memory(system.state.ram, RAM_SIZE);
+}
+
+/**
+ * Run every slot of the pool for a frame twice, recycled (reset = 0) or reset in place (reset = 1)
+ * between the runs. Returns the number of instances that differ from a fresh copy.
+*/
+int check_recycling(instance_pool *pool, uint64_t expected, int reset) {
+    arcade_system *live[LIVE_INSTANCES];
+    int failed = 0;
+
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        live[i] = acquire_instance(pool);
+        emulate_frame(live[i]);
+        emulate_frame(live[i]);
+    }
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        if (reset) {
+            reset_pool_instance(pool, live[i]);
+        } else {
+            release_instance(pool, live[i]);
+            live[i] = acquire_instance(pool);
+        }
+        emulate_frame(live[i]);
+        failed += hash_memory(live[i]->state.ram, RAM_SIZE) != expected;
+    }
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        release_instance(pool, live[i]);
+    }
+    return failed;
+}
+
+/**
+ * Create and destroy instances from the pool
+*/
+double churn_pool(instance_pool *pool, int cycles) {
+    arcade_system *live[LIVE_INSTANCES] = {NULL};
+    double start = time_in_seconds();
+
+    for (int i = 0; i < cycles; i++) {
+        arcade_system **slot = &live[i % LIVE_INSTANCES];
+
+        if (*slot) {
+            release_instance(pool, *slot);
+        }
+        *slot = acquire_instance(pool);
+    }
+    start = (time_in_seconds() - start) * 1e9 / cycles;
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        if (live[i]) {
+            release_instance(pool, live[i]);
+        }
+    }
+    return start;
+}
+
+/**
+ * The same with aligned_alloc() and free()
+*/
+double churn_malloc(arcade_system *template, int cycles) {
+    arcade_system *live[LIVE_INSTANCES] = {NULL};
+    double start = time_in_seconds();
+
+    for (int i = 0; i < cycles; i++) {
+        arcade_system **slot = &live[i % LIVE_INSTANCES];
+
+        free(*slot);
+        *slot = aligned_alloc(64, sizeof(arcade_system));
+        if (!*slot) {
+            printf("Out of memory!\n");
+            exit(1);
+        }
+        copy_arcade_machine(*slot, template);
+    }
+    start = (time_in_seconds() - start) * 1e9 / cycles;
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        free(live[i]);
+    }
+    return start;
+}
+
+/**
+ * Reset live instances in place
+*/
+double churn_reset(instance_pool *pool, int cycles) {
+    arcade_system *live[LIVE_INSTANCES];
+    double start = 0;
+
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        live[i] = acquire_instance(pool);
+    }
+    start = time_in_seconds();
+    for (int i = 0; i < cycles; i++) {
+        reset_pool_instance(pool, live[i % LIVE_INSTANCES]);
+    }
+    start = (time_in_seconds() - start) * 1e9 / cycles;
+    for (int i = 0; i < LIVE_INSTANCES; i++) {
+        release_instance(pool, live[i]);
+    }
+    return start;
+}
+
+/**
+ * Usage: pool_bench [-c create / destroy cycles] [-s (small pages)] <ini file>
+*/
+int main(int argc, char *argv[]) {
+    static arcade_system template;
+    instance_pool pool;
+    int cycles = DEFAULT_CYCLES, pages = POOL_HUGE_PAGES, option = 0, failed = 0;
+    uint64_t expected = 0;
+
+    while ((option = getopt(argc, argv, "c:s")) != -1) {
+        if (option == 'c') {
+            cycles = atoi(optarg);
+        } else if (option == 's') {
+            pages = POOL_SMALL_PAGES;
+        } else {
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || cycles < 1) {
+        printf("Usage: pool_bench [-c create / destroy cycles] [-s (small pages)] <ini file>\n");
+        return 1;
+    }
+
+    if (!rom_set_readable(argv[optind])) {
+        printf("%s\tskipped (ROM files missing or unreadable)\n", argv[optind]);
+        return 0;
+    }
+
+    initialize_arcade_machine(&template);
+    load_config_file(&template, argv[optind]);
+    start_arcade_machine(&template);
+    expected = fresh_hash(&template);
+
+    create_instance_pool(&pool, &template, LIVE_INSTANCES, pages);
+    printf("# %d slots of %zu bytes on %s\n", pool.capacity, sizeof(arcade_system), page_names[pool.pages]);
+    printf("# method\tns_per_instance\n");
+    printf("pool\t%.0f\n", churn_pool(&pool, cycles));
+    printf("malloc\t%.0f\n", churn_malloc(&template, cycles));
+    printf("reset\t%.0f\n", churn_reset(&pool, cycles));
+    failed = check_recycling(&pool, expected, 0) + check_recycling(&pool, expected, 1);
+    printf("Recycled instances: %s\n", failed ? "DIFFERENT" : "ok");
+
+    destroy_instance_pool(&pool);
+    release_arcade_machine(&template);
+    return failed ? 1 : 0;
+}
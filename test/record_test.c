@@ -0,0 +1,187 @@
+// ****************************************************************************************
+// * Recorder test
+// * Records changing video RAM contents with sound triggers as Y4M and as PNG sequence,
+// * then reads the files back: every frame must show the upright screen of its video RAM
+// * and the triggered sample must start in the WAV file at the frame of its trigger.
+// * The µs the emulation thread spends per queued frame are printed. The files are
+// * written to the current directory and removed afterwards.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "recorder.h"
+#include "config_rom_loader.h"
+#include "observation.h"
+#include "video_frame.h"
+#include "test_timer.h"
+
+#define FRAMES 300
+#define FRAME_BYTES (GAME_WIDTH * GAME_HEIGHT / 8)
+#define SOUND_FRAME 100                       // The sample is triggered during this frame
+#define SAMPLE_FILE "record_test_sample.wav"  // 8 bit, 11025 Hz square wave
+#define Y4M_FRAME (UPRIGHT_WIDTH * UPRIGHT_HEIGHT * 3 / 2)
+
+arcade_system system_state;
+uint8_t frames[FRAMES][FRAME_BYTES];
+uint8_t file_buffer[Y4M_FRAME + 4096];
+uint32_t random_state = 99;
+double queue_seconds = 0;
+
+uint8_t random_byte(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 16;
+}
+
+int expected_pixel(const uint8_t *frame, int x, int y) {
+    int bit = GAME_WIDTH - 1 - y;
+
+    return (frame[x * 32 + bit / 8] >> (bit % 8)) & 1;
+}
+
+void write_test_sample(void) {
+    uint8_t header[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\x11\x2B\0\0\x11\x2B\0\0\x01\0\x08\0data";
+    FILE *file = fopen(SAMPLE_FILE, "wb");
+
+    header[40] = 200;  // 200 samples
+    fwrite(header, 1, sizeof(header), file);
+    for (int i = 0; i < 200; i++) {
+        fputc(i % 20 < 10 ? 228 : 28, file);
+    }
+    fclose(file);
+}
+
+/**
+ * Record the frames, sample 1 (port 3 bit 1) is triggered during SOUND_FRAME
+*/
+void record_session(int format, const char *name) {
+    uint8_t *video_ram = &system_state.state.ram[VIDEO_RAM - RAM_START];
+    double start = 0;
+
+    memset(&system_state, 0, sizeof(system_state));
+    strcpy(system_state.sample_filepath[1], SAMPLE_FILE);
+    system_state.record = format;
+    initialize_recorder(&system_state, name);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        if (frame == SOUND_FRAME) {
+            record_sound_event(&system_state, 3, 0x02);
+            system_state.sound_latch[0] = 0x02;
+        }
+        memcpy(video_ram, frames[frame], FRAME_BYTES);
+        system_state.frame_count = frame;
+        start = time_in_seconds();
+        record_frame(&system_state);
+        queue_seconds += time_in_seconds() - start;
+    }
+    close_recorder();
+}
+
+int check_y4m(void) {
+    FILE *file = fopen("record_test.y4m", "rb");
+    int failed = 0;
+
+    if (!file || !fgets((char *)file_buffer, sizeof(file_buffer), file) || strncmp((char *)file_buffer, "YUV4MPEG2 W224 H256", 19)) {
+        printf("Y4M header missing\n");
+        return 1;
+    }
+    for (int frame = 0; frame < FRAMES; frame++) {
+        if (fread(file_buffer, 1, 6 + Y4M_FRAME, file) != 6 + Y4M_FRAME || memcmp(file_buffer, "FRAME\n", 6)) {
+            printf("Y4M frame %d missing\n", frame);
+            failed++;
+            break;
+        }
+        for (int y = 0; y < UPRIGHT_HEIGHT; y++) {
+            for (int x = 0; x < UPRIGHT_WIDTH; x++) {
+                failed += file_buffer[6 + y * UPRIGHT_WIDTH + x] != (expected_pixel(frames[frame], x, y) ? 255 : 0);
+            }
+        }
+    }
+    failed += fread(file_buffer, 1, 1, file) != 0;
+    fclose(file);
+    return failed;
+}
+
+int check_png(void) {
+    char filename[64];
+    FILE *file = NULL;
+    size_t size = 0;
+    uint8_t *raw = NULL;
+    int failed = 0;
+
+    for (int frame = 0; frame < FRAMES; frame += 37) {
+        snprintf(filename, sizeof(filename), "record_test-%06d.png", frame);
+        file = fopen(filename, "rb");
+        size = file ? fread(file_buffer, 1, sizeof(file_buffer), file) : 0;
+        if (file) {
+            fclose(file);
+        }
+        // Signature, IHDR (25 bytes), IDAT with zlib header, stored block header and the raw rows
+        raw = &file_buffer[8 + 25 + 8 + 2 + 5];
+        if (size < 8 + 25 + 8 + 7 || memcmp(&file_buffer[1], "PNG", 3) || memcmp(&file_buffer[37], "IDAT", 4)
+            || file_buffer[12 + 17] != crc32(&file_buffer[12], 17) >> 24) {
+            printf("PNG file %s invalid\n", filename);
+            failed++;
+            continue;
+        }
+        for (int y = 0; y < UPRIGHT_HEIGHT; y++) {
+            for (int x = 0; x < UPRIGHT_WIDTH; x++) {
+                int pixel = (raw[y * 29 + 1 + x / 8] >> (7 - x % 8)) & 1;
+
+                failed += pixel != expected_pixel(frames[frame], x, y);
+            }
+        }
+    }
+    return failed;
+}
+
+int check_wav(void) {
+    FILE *file = fopen("record_test.wav", "rb");
+    int16_t sample = 0;
+    int samples = FRAMES * 48000 / FRAMERATE, first = -1, failed = 0;
+    uint8_t header[44];
+
+    if (!file || fread(header, 1, 44, file) != 44) {
+        printf("WAV file missing\n");
+        return 1;
+    }
+    failed += (header[40] | header[41] << 8 | header[42] << 16) != 2 * samples;
+    for (int i = 0; i < samples && fread(&sample, 2, 1, file) == 1; i++) {
+        if (sample && first < 0) {
+            first = i;
+        }
+    }
+    fclose(file);
+    failed += first != (int)(SOUND_FRAME * 48000 / FRAMERATE);  // Start of the frame
+    return failed;
+}
+
+int main(void) {
+    char filename[64];
+    int failed = 0;
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (int i = 0; i < FRAME_BYTES; i++) {
+            frames[frame][i] = frame == 0 ? random_byte() : (random_byte() & 15) == 0 ? random_byte() : frames[frame - 1][i];
+        }
+    }
+    write_test_sample();
+
+    record_session(RECORD_Y4M, "record_test");
+    failed += check_y4m();
+    failed += check_wav();
+    printf("Y4M and WAV: %s\n", failed ? "FAILED" : "passed");
+
+    record_session(RECORD_PNG, "record_test");
+    failed += check_png();
+    printf("PNG sequence: %s\n", failed ? "FAILED" : "passed");
+    printf("Emulation thread: %.1f µs per recorded frame\n", queue_seconds * 1e6 / (2 * FRAMES));
+
+    remove("record_test.y4m");
+    remove("record_test.wav");
+    remove(SAMPLE_FILE);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        snprintf(filename, sizeof(filename), "record_test-%06d.png", frame);
+        remove(filename);
+    }
+    return failed ? 1 : 0;
+}
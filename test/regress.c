@@ -0,0 +1,492 @@
+// ****************************************************************************************
+// * Golden frame regression test
+// * Records (-r) or compares (-c) the per-frame hashes of the video RAM and the work RAM
+// * of each combination of the given ROM set configurations and input traces (movies).
+// * The golden file additionally holds the full RAM every keyframe interval, so that a
+// * divergence is reported with its first frame and the differing bytes.
+// * The combinations are independent emulator instances, each run in its own child process
+// * (several at a time): a job ending the process on a fatal emulation error fails alone.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/wait.h>
+#include "arcade.h"
+#include "config_rom_loader.h"
+#include "state_hash.h"
+#include "input_trace.h"
+#include "test_timer.h"
+
+#define DEFAULT_FRAMES 18000
+#define DEFAULT_KEYFRAMES 60       // Full RAM stored every 60 frames
+#define MAX_REPORTED_BYTES 32
+#define MAX_ROM_SETS 64
+#define MAX_TRACES 16
+#define MAX_PROCESSES 256
+#define REPORT_SIZE 2048
+
+enum Job_result {
+    RESULT_PASSED,
+    RESULT_RECORDED,
+    RESULT_DIVERGED,
+    RESULT_NO_GOLDEN,
+    RESULT_ABORTED,                // The job process ended without a result
+};
+
+typedef struct {
+    char magic[4];                 // "I8GF"
+    uint32_t version;
+    uint64_t frames;
+    uint32_t keyframe_interval;
+    uint32_t reserved;
+    uint64_t trace_hash;           // The golden file is only valid for the same input trace
+} golden_header;
+
+// ROM set configuration loaded once, copied into the instance of each job
+typedef struct {
+    char *filename;
+    int loaded;                    // 0 = ROM files missing or unreadable
+    arcade_system machine;         // State after loading the configuration and the ROMs
+} rom_set;
+
+// Trace file (input movie) shared read-only by the jobs, each job keeps its own position
+typedef struct {
+    char *filename;
+    input_trace trace;
+    uint64_t hash;
+} movie;
+
+// One ROM set / movie combination
+typedef struct {
+    rom_set *set;
+    movie *movie;
+    char golden[512];              // Golden file path
+    int result;
+    double seconds;
+    uint64_t frames;
+    char report[REPORT_SIZE];      // Result details printed after all jobs finished
+    int report_length;
+} job;
+
+rom_set rom_sets[MAX_ROM_SETS];
+movie movies[MAX_TRACES];
+job *jobs = NULL;
+int rom_set_count = 0, movie_count = 0, job_count = 0;
+
+// Running job processes
+typedef struct {
+    pid_t pid;
+    int job;
+    int fd;                        // Read end of the pipe the job is passed back through
+    double start;
+} job_process;
+
+int record = 0;
+uint64_t frames = DEFAULT_FRAMES;
+uint32_t keyframe_interval = DEFAULT_KEYFRAMES;
+int idle_skip = -1, hle_mode = -1;  // Override the ROM set configuration if set
+char *golden_directory = "golden";
+
+/**
+ * Append a line to the result details of a job
+*/
+void report(job *job, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    if (job->report_length < REPORT_SIZE) {
+        job->report_length += vsnprintf(&job->report[job->report_length], REPORT_SIZE - job->report_length, format, args);
+    }
+    va_end(args);
+}
+
+/**
+ * Hash of the input trace events, stored in the golden file
+*/
+uint64_t hash_trace(input_trace *trace) {
+    uint64_t hash = 0, event[2];
+
+    for (int i = 0; i < trace->count; i++) {
+        event[0] = trace->events[i].frame;
+        event[1] = trace->events[i].input;
+        hash = hash * 31 + hash_memory((uint8_t *)event, sizeof(event));
+    }
+    return hash;
+}
+
+/**
+ * Receive a block (loaded ROM set or finished job) from a child process, returns 0 when incomplete
+*/
+int receive_block(int fd, void *buffer, size_t size) {
+    uint8_t *data = buffer;
+    ssize_t bytes = 0;
+    size_t received = 0;
+
+    while (received < size && (bytes = read(fd, &data[received], size - received)) > 0) {
+        received += bytes;
+    }
+    return received == size;
+}
+
+/**
+ * Load a ROM set configuration in a child process, the configuration loader ends the process on missing ROM files.
+ * The loaded machine and its ROM bank are passed back through a pipe, the console output of the ROM loading is suppressed.
+*/
+void load_rom_set(rom_set *set) {
+    static arcade_system system;
+    rom_bank *bank = NULL;
+    int fd[2], status = 0, received = 0;
+    pid_t pid = 0;
+
+    set->loaded = 0;
+    if (pipe(fd) != 0) {
+        return;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        close(fd[0]);
+        if (!freopen("/dev/null", "w", stdout)) {
+            exit(1);
+        }
+        initialize_arcade_machine(&system);
+        load_config_file(&system, set->filename);
+        exit(write(fd[1], &system, sizeof(system)) == sizeof(system)
+             && write(fd[1], system.state.rom, ROM_SIZE) == ROM_SIZE ? 0 : 1);
+    }
+    close(fd[1]);
+    initialize_arcade_machine(&set->machine);  // Own ROM bank in this process
+    bank = set->machine.rom_bank;
+    received = receive_block(fd[0], &set->machine, sizeof(arcade_system));
+    set->machine.rom_bank = bank;
+    set->machine.state.rom = bank->rom;
+    received = received && receive_block(fd[0], bank->rom, ROM_SIZE);
+    close(fd[0]);
+    waitpid(pid, &status, 0);
+    set->loaded = received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (set->loaded) {
+        seal_rom_bank(&set->machine);  // Before the jobs share it
+    }
+}
+
+/**
+ * Start the instance of a job from the loaded ROM set with the configuration overrides applied
+*/
+void start_instance(arcade_system *system, job *job, input_trace *trace) {
+    *system = job->set->machine;
+    if (idle_skip >= 0) {
+        system->idle_skip = idle_skip;
+    }
+    if (hle_mode >= 0) {
+        system->hle_mode = hle_mode;
+    }
+    start_arcade_machine(system);
+    *trace = job->movie->trace;
+    rewind_trace(trace);
+}
+
+/**
+ * Record the golden file of a job
+*/
+int record_golden(arcade_system *system, input_trace *trace, job *job, FILE *golden) {
+    golden_header header = {{'I', '8', 'G', 'F'}, 1, frames, keyframe_interval, 0, job->movie->hash};
+    frame_hash hash;
+
+    fwrite(&header, sizeof(header), 1, golden);
+    while (system->frame_count < frames) {
+        apply_trace(trace, system);
+        emulate_frame(system);
+        hash_frame(system, &hash);
+        fwrite(&hash, sizeof(hash), 1, golden);
+        if (system->frame_count % keyframe_interval == 0) {
+            fwrite(system->state.ram, 1, RAM_SIZE, golden);
+        }
+    }
+    return RESULT_RECORDED;
+}
+
+/**
+ * Print the RAM bytes differing from the golden keyframe
+*/
+void report_differences(arcade_system *system, uint8_t *golden_ram, job *job) {
+    int reported = 0;
+
+    for (int i = 0; i < RAM_SIZE; i++) {
+        if (system->state.ram[i] != golden_ram[i]) {
+            if (reported < MAX_REPORTED_BYTES) {
+                report(job, "    %04X: golden %02X, now %02X\n", RAM_START + i, golden_ram[i], system->state.ram[i]);
+            }
+            reported++;
+        }
+    }
+    report(job, "    %d bytes differ\n", reported);
+}
+
+/**
+ * Compare a job run with its golden file. After the first divergent frame the emulation continues
+ * to the next keyframe to report the differing bytes.
+*/
+int compare_golden(arcade_system *system, input_trace *trace, job *job, FILE *golden) {
+    uint8_t golden_ram[RAM_SIZE];
+    golden_header header;
+    frame_hash hash, expected;
+    uint64_t divergent = 0;
+    int keyframe = 0;
+
+    if (fread(&header, sizeof(header), 1, golden) != 1 || memcmp(header.magic, "I8GF", 4) != 0 || header.version != 1) {
+        report(job, "    invalid golden file %s\n", job->golden);
+        return RESULT_NO_GOLDEN;
+    }
+    if (header.trace_hash != job->movie->hash) {
+        report(job, "    %s has been recorded with another input trace\n", job->golden);
+        return RESULT_NO_GOLDEN;
+    }
+    while (system->frame_count < header.frames) {
+        apply_trace(trace, system);
+        emulate_frame(system);
+        hash_frame(system, &hash);
+        keyframe = system->frame_count % header.keyframe_interval == 0;
+        if (fread(&expected, sizeof(expected), 1, golden) != 1
+            || (keyframe && fread(golden_ram, 1, RAM_SIZE, golden) != RAM_SIZE)) {
+            report(job, "    golden file truncated at frame %llu\n", (unsigned long long)system->frame_count);
+            return RESULT_NO_GOLDEN;
+        }
+        if (!divergent && (hash.video != expected.video || hash.work != expected.work)) {
+            divergent = system->frame_count;
+            report(job, "    first divergent frame %llu:%s%s\n", (unsigned long long)divergent,
+                hash.video != expected.video ? " video RAM" : "", hash.work != expected.work ? " work RAM" : "");
+        }
+        if (divergent && keyframe) {
+            report(job, "    RAM at frame %llu:\n", (unsigned long long)system->frame_count);
+            report_differences(system, golden_ram, job);
+            return RESULT_DIVERGED;
+        }
+    }
+    return divergent ? RESULT_DIVERGED : RESULT_PASSED;  // No keyframe after the divergence
+}
+
+/**
+ * Record or compare one ROM set / movie combination on its own emulator instance
+*/
+void run_job(job *job) {
+    arcade_system *system = aligned_alloc(64, sizeof(arcade_system));
+    input_trace *trace = malloc(sizeof(input_trace));
+    double start = time_in_seconds();
+    FILE *golden = NULL;
+
+    if (!system || !trace) {
+        fprintf(stderr, "Out of memory!\n");
+        exit(1);
+    }
+    start_instance(system, job, trace);
+    golden = fopen(job->golden, record ? "wb" : "rb");
+    if (!golden) {
+        report(job, "    could not open %s\n", job->golden);
+        job->result = RESULT_NO_GOLDEN;
+    } else {
+        job->result = record ? record_golden(system, trace, job, golden) : compare_golden(system, trace, job, golden);
+        fclose(golden);
+    }
+    job->frames = system->frame_count;
+    job->seconds = time_in_seconds() - start;
+    free(trace);
+    free(system);
+}
+
+/**
+ * Run a job in a child process which passes the finished job back through a pipe.
+ * The console output of the instance (e.g. HLE routines found) is suppressed.
+*/
+int start_job_process(job_process *process, int index) {
+    int fd[2];
+
+    if (pipe(fd) != 0) {
+        return 0;
+    }
+    fflush(stdout);
+    process->pid = fork();
+    if (process->pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return 0;
+    }
+    if (process->pid == 0) {
+        close(fd[0]);
+        if (!freopen("/dev/null", "w", stdout)) {
+            exit(1);
+        }
+        run_job(&jobs[index]);
+        exit(write(fd[1], &jobs[index], sizeof(job)) == sizeof(job) ? 0 : 1);
+    }
+    close(fd[1]);
+    process->job = index;
+    process->fd = fd[0];
+    process->start = time_in_seconds();
+    return 1;
+}
+
+/**
+ * Collect the result of a finished job process. A process which ended without a result (e.g. a fatal
+ * emulation error calling exit()) fails its job with the exit status.
+*/
+void finish_job_process(job_process *process, int status) {
+    job result;
+    job *job = &jobs[process->job];
+
+    if (receive_block(process->fd, &result, sizeof(result)) && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        *job = result;
+    } else {
+        job->result = RESULT_ABORTED;
+        job->seconds = time_in_seconds() - process->start;
+        if (WIFSIGNALED(status)) {
+            report(job, "    emulation ended by signal %d\n", WTERMSIG(status));
+        } else {
+            report(job, "    emulation ended the process (exit status %d)\n", WEXITSTATUS(status));
+        }
+    }
+    close(process->fd);
+}
+
+/**
+ * Run all jobs with up to count job processes at a time
+*/
+void run_jobs(int count) {
+    static job_process processes[MAX_PROCESSES];
+    int running = 0, next = 0, status = 0;
+    pid_t pid = 0;
+
+    while (next < job_count || running > 0) {
+        if (next < job_count && running < count && start_job_process(&processes[running], next)) {
+            running++;
+            next++;
+            continue;
+        }
+        if (running == 0) {
+            printf("Could not start a job process!\n");
+            exit(1);
+        }
+        pid = waitpid(-1, &status, 0);
+        for (int i = 0; i < running; i++) {
+            if (processes[i].pid == pid) {
+                finish_job_process(&processes[i], status);
+                processes[i] = processes[--running];
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Golden file name: <ini file>[.<trace file without extension>].golden
+*/
+void golden_path(job *job) {
+    char ini[256], trace[256], *name = NULL, *dot = NULL;
+
+    strncpy(ini, job->set->filename, sizeof(ini) - 1);
+    ini[sizeof(ini) - 1] = 0;
+    if (!job->movie->filename) {
+        snprintf(job->golden, sizeof(job->golden), "%s/%s.golden", golden_directory, basename(ini));
+        return;
+    }
+    strncpy(trace, job->movie->filename, sizeof(trace) - 1);
+    trace[sizeof(trace) - 1] = 0;
+    name = basename(trace);
+    dot = strrchr(name, '.');
+    if (dot) {
+        *dot = 0;
+    }
+    snprintf(job->golden, sizeof(job->golden), "%s/%s.%s.golden", golden_directory, basename(ini), name);
+}
+
+/**
+ * Usage: regress -r|-c [-j processes] [-g golden directory] [-f frames] [-k keyframe interval] [-t input trace]...
+ *                [-i idle skip] [-H hle mode] <ini files>
+*/
+int main(int argc, char *argv[]) {
+    const char *result_names[] = {"PASS", "recorded", "FAIL", "FAIL", "FAIL"};
+    int option = 0, mode = 0, process_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int passed = 0, failed = 0, skipped = 0;
+    double start = 0, wall = 0, busy = 0;
+
+    while ((option = getopt(argc, argv, "rcj:g:f:k:t:i:H:")) != -1) {
+        switch (option) {
+        case 'r': record = 1; mode = 1;                           break;
+        case 'c': record = 0; mode = 1;                           break;
+        case 'j': process_count = atoi(optarg);                   break;
+        case 'g': golden_directory = optarg;                      break;
+        case 'f': frames = strtoull(optarg, NULL, 10);            break;
+        case 'k': keyframe_interval = atoi(optarg);               break;
+        case 'i': idle_skip = atoi(optarg);                       break;
+        case 'H': hle_mode = atoi(optarg);                        break;
+        case 't':
+            if (movie_count < MAX_TRACES) {
+                movies[movie_count].filename = optarg;
+                load_trace(&movies[movie_count++].trace, optarg);
+            }
+            break;
+        default: mode = 0;                                        break;
+        }
+    }
+    if (!mode || keyframe_interval == 0) {
+        printf("Usage: regress -r|-c [-j processes] [-g golden directory] [-f frames] [-k keyframe interval]\n"
+               "               [-t input trace]... [-i idle skip] [-H hle mode] <ini files>\n");
+        return 1;
+    }
+    if (process_count < 1) {
+        process_count = 1;
+    }
+    if (process_count > MAX_PROCESSES) {
+        process_count = MAX_PROCESSES;
+    }
+    if (movie_count == 0) {
+        movie_count = 1;  // No input at all
+    }
+    for (int i = 0; i < movie_count; i++) {
+        movies[i].hash = hash_trace(&movies[i].trace);
+    }
+
+    // Load each ROM set once, then queue every ROM set / movie combination
+    for (int i = optind; i < argc && rom_set_count < MAX_ROM_SETS; i++) {
+        rom_sets[rom_set_count].filename = argv[i];
+        load_rom_set(&rom_sets[rom_set_count++]);
+    }
+    jobs = calloc(rom_set_count * movie_count + 1, sizeof(job));
+    for (int i = 0; i < rom_set_count; i++) {
+        for (int j = 0; j < movie_count && rom_sets[i].loaded; j++) {
+            jobs[job_count].set = &rom_sets[i];
+            jobs[job_count].movie = &movies[j];
+            golden_path(&jobs[job_count++]);
+        }
+    }
+
+    start = time_in_seconds();
+    run_jobs(process_count);
+    wall = time_in_seconds() - start;
+
+    for (int i = 0; i < rom_set_count; i++) {
+        if (!rom_sets[i].loaded) {
+            printf("%s\tskipped (ROM files missing or unreadable)\n", rom_sets[i].filename);
+            skipped++;
+        }
+    }
+    for (int i = 0; i < job_count; i++) {
+        printf("%s\t%s\t%s\t%llu frames\t%.2fs\t%.0f fps\n", jobs[i].set->filename,
+            jobs[i].movie->filename ? jobs[i].movie->filename : "-", result_names[jobs[i].result],
+            (unsigned long long)jobs[i].frames, jobs[i].seconds, jobs[i].seconds > 0 ? jobs[i].frames / jobs[i].seconds : 0.0);
+        printf("%s", jobs[i].report);
+        passed += jobs[i].result == RESULT_PASSED || jobs[i].result == RESULT_RECORDED;
+        busy += jobs[i].seconds;
+    }
+    failed = job_count - passed;
+    printf("%d passed, %d failed, %d ROM sets skipped in %.2fs with %d processes (%.2fs emulation time, %.1fx)\n",
+        passed, failed, skipped, wall, process_count, busy, wall > 0 ? busy / wall : 0.0);
+    for (int i = 0; i < rom_set_count; i++) {
+        release_arcade_machine(&rom_sets[i].machine);
+    }
+    free(jobs);
+    return failed ? 1 : 0;
+}
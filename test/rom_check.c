@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "arcade.h"
+#include "config_rom_loader.h"
+#include "rom_check.h"
+
+/**
+ * Load the ROM set in a child process: a missing ROM file ends the child through exit() without taking the
+ * caller down. Returns 1 if the ROM set could be loaded, the console output of the child is suppressed.
+*/
+int rom_set_readable(char *filename) {
+    static arcade_system system;
+    pid_t pid = 0;
+    int status = 0;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        return 0;
+    }
+    if (pid == 0) {
+        if (!freopen("/dev/null", "w", stdout)) {
+            exit(1);
+        }
+        initialize_arcade_machine(&system);
+        load_config_file(&system, filename);
+        exit(0);
+    }
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
@@ -0,0 +1,7 @@
+#ifndef ROM_CHECK_H
+#define ROM_CHECK_H
+
+// ROM set check (benchmarks and tests which need the game ROMs)
+int rom_set_readable(char *filename);
+
+#endif
@@ -0,0 +1,130 @@
+// ****************************************************************************************
+// * Environment server test
+// * Runs the server on a thread and talks to it like a client process: the instances
+// * are reset and stepped with pseudo random inputs over the socket and the observations,
+// * game states and RAM in the shared memory are compared with a local vector environment
+// * stepped with the same inputs. Invalid requests must be answered with an error status.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "env_server.h"
+#include "rom_check.h"
+
+#define INSTANCES 16
+#define FRAMES 300
+#define TEST_SOCKET "/tmp/invaders-server-test.sock"
+
+env_server server;
+int client = -1;
+
+void *server_thread(void *argument) {
+    run_env_server(argument);
+    return NULL;
+}
+
+/**
+ * Send a request and receive the status, the response payload goes to payload (up to size bytes)
+*/
+int request(int command, int argument, const void *data, uint32_t data_size, void *payload, uint32_t size) {
+    server_request message = {command, argument, data_size};
+    server_response response = {SERVER_BAD_COMMAND, 0};
+
+    if (send(client, &message, sizeof(message), 0) != sizeof(message)
+        || (data_size && send(client, data, data_size, 0) != (ssize_t)data_size)
+        || recv(client, &response, sizeof(response), MSG_WAITALL) != sizeof(response)
+        || response.size > size
+        || (response.size && recv(client, payload, response.size, MSG_WAITALL) != (ssize_t)response.size)) {
+        printf("Connection lost\n");
+        exit(1);
+    }
+    return response.status;
+}
+
+int main(int argc, char *argv[]) {
+    struct sockaddr_un address;
+    server_info info;
+    server_memory *memory = NULL;
+    uint8_t *shared = NULL, inputs[INSTANCES];
+    vector_env *env = NULL, *local = NULL;
+    pthread_t thread;
+    uint32_t random = 4711;
+    int fd = 0, failed = 0;
+
+    if (argc != 2) {
+        printf("Usage: server_test <ini file>\n");
+        return 1;
+    }
+    if (!rom_set_readable(argv[1])) {
+        printf("%s\tskipped (ROM files missing or unreadable)\n", argv[1]);
+        return 0;
+    }
+    env = create_vector_env(argv[1], INSTANCES, 2);
+    local = create_vector_env(argv[1], INSTANCES, 1);
+    create_env_server(&server, env, TEST_SOCKET);
+    pthread_create(&thread, NULL, server_thread, &server);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, TEST_SOCKET, sizeof(address.sun_path) - 1);
+    client = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client < 0 || connect(client, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        printf("Cannot connect to %s\n", TEST_SOCKET);
+        return 1;
+    }
+
+    failed += request(SERVER_INFO, 0, NULL, 0, &info, sizeof(info)) != SERVER_OK;
+    failed += info.magic != SERVER_MAGIC || info.version != SERVER_VERSION || info.count != INSTANCES;
+    fd = shm_open(info.shared_name, O_RDWR, 0);
+    shared = fd < 0 ? MAP_FAILED : mmap(NULL, info.shared_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (shared == MAP_FAILED) {
+        printf("Cannot map the shared memory %s\n", info.shared_name);
+        return 1;
+    }
+    close(fd);
+    memory = (server_memory *)shared;
+
+    failed += request(SERVER_RESET, -1, NULL, 0, NULL, 0) != SERVER_OK;
+    reset_vector_env(local, -1);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (int i = 0; i < INSTANCES; i++) {
+            random = random * 1103515245 + 12345;
+            inputs[i] = frame % 8 ? inputs[i] : (random >> 16) & 0x7F;
+        }
+        if (frame == FRAMES / 2) {
+            failed += request(SERVER_RESET, 3, NULL, 0, NULL, 0) != SERVER_OK;
+            reset_vector_env(local, 3);
+        }
+        failed += request(SERVER_STEP, 0, inputs, INSTANCES, NULL, 0) != SERVER_OK;
+        step_vector_env(local, inputs);
+    }
+    failed += request(SERVER_FETCH_RAM, 0, NULL, 0, NULL, 0) != SERVER_OK;
+    failed += memory->steps != FRAMES;
+    failed += memcmp(shared + memory->observations, local->observations, (size_t)INSTANCES * OBSERVATION_SIZE) != 0;
+    failed += local->ram_map && memcmp(shared + memory->game_states, local->game_states, INSTANCES * sizeof(game_state)) != 0;
+    for (int i = 0; i < INSTANCES; i++) {
+        failed += memcmp(shared + memory->ram + (size_t)i * RAM_SIZE, local->instances[i].state.ram, RAM_SIZE) != 0;
+    }
+    printf("Steps over the socket: %s\n", failed ? "FAILED" : "passed");
+
+    failed += request(SERVER_RESET, INSTANCES, NULL, 0, NULL, 0) != SERVER_BAD_ARGUMENT;
+    failed += request(SERVER_STEP, 0, inputs, INSTANCES - 1, NULL, 0) != SERVER_BAD_ARGUMENT;
+    failed += request(99, 0, NULL, 0, NULL, 0) != SERVER_BAD_COMMAND;
+    failed += request(SERVER_SHUTDOWN, 0, NULL, 0, NULL, 0) != SERVER_OK;
+    pthread_join(thread, NULL);
+    printf("Invalid requests and shutdown: %s\n", failed ? "FAILED" : "passed");
+
+    close(client);
+    munmap(shared, info.shared_size);
+    destroy_env_server(&server, TEST_SOCKET);
+    destroy_vector_env(env);
+    destroy_vector_env(local);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+#include <time.h>
+#include "test_timer.h"
+
+/**
+ * Monotonic wall clock time in seconds
+*/
+double time_in_seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
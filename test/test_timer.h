@@ -0,0 +1,7 @@
+#ifndef TEST_TIMER_H
+#define TEST_TIMER_H
+
+// Timing API (test programs and benchmarks)
+double time_in_seconds(void);
+
+#endif
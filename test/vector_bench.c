@@ -0,0 +1,119 @@
+// ****************************************************************************************
+// * Vector environment benchmark
+// * Steps a batch of instances of one ROM set with pseudo random inputs on 1, 2, 4, ...
+// * threads and prints the instance frames per second. The observations after the last
+// * step must not depend on the number of threads. With a known ROM set the
+// * game variables of the first instance are printed. -p adds stacks of the last 4
+// * observations downsampled to 84 x 84.
+// ****************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "vector_env.h"
+#include "state_hash.h"
+#include "test_timer.h"
+#include "rom_check.h"
+
+#define DEFAULT_INSTANCES 64
+#define DEFAULT_FRAMES 600
+#define MAX_INSTANCES 65536
+
+const observation_spec atari_spec = {0, 0, UPRIGHT_WIDTH, UPRIGHT_HEIGHT, 84, 84, OBSERVATION_MAX};  // -p: 4 stacked 84 x 84 frames
+
+/**
+ * Step all instances for the given frames, the inputs change every 8 frames per instance
+*/
+uint64_t run_batch(vector_env *env, int frames, double *seconds) {
+    static uint8_t inputs[MAX_INSTANCES];
+    uint32_t random = 12345;
+    uint64_t hash = 0;
+    double start = 0;
+
+    reset_vector_env(env, -1);
+    start = time_in_seconds();
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < env->count && frame % 8 == 0; i++) {
+            random = random * 1103515245 + 12345;
+            inputs[i] = frame < 300 ? (frame >= 120 && frame < 130 ? INPUT_COIN : frame >= 180 && frame < 190 ? INPUT_START1 : 0)
+                                    : (random >> 16) & (INPUT_LEFT | INPUT_RIGHT | INPUT_SHOT);
+        }
+        step_vector_env(env, inputs);
+    }
+    *seconds = time_in_seconds() - start;
+    hash = hash_memory(env->observations, (size_t)env->count * OBSERVATION_SIZE);
+    for (int i = 0; env->frame_stacks && i < env->count; i++) {
+        hash = hash * 31 + hash_memory(stacked_frames(&env->frame_stacks[i]), env->frame_stacks[i].depth * env->frame_stacks[i].frame_size);
+    }
+    return hash;
+}
+
+/**
+ * Usage: vector_bench [-p] [-n instances] [-f frames] [-j max threads] <ini file>
+*/
+int main(int argc, char *argv[]) {
+    int instances = DEFAULT_INSTANCES, frames = DEFAULT_FRAMES, max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int option = 0, failed = 0, console = 0, preprocessing = 0;
+    uint64_t hash = 0, reference = 0;
+    double seconds = 0;
+    vector_env *env = NULL;
+
+    while ((option = getopt(argc, argv, "pn:f:j:")) != -1) {
+        switch (option) {
+        case 'p': preprocessing = 1;            break;
+        case 'n': instances = atoi(optarg);     break;
+        case 'f': frames = atoi(optarg);        break;
+        case 'j': max_threads = atoi(optarg);   break;
+        default: optind = argc + 1;             break;
+        }
+    }
+    if (optind != argc - 1 || instances < 1 || instances > MAX_INSTANCES) {
+        printf("Usage: vector_bench [-p] [-n instances] [-f frames] [-j max threads] <ini file>\n");
+        return 1;
+    }
+
+    if (!rom_set_readable(argv[optind])) {
+        printf("%s\tskipped (ROM files missing or unreadable)\n", argv[optind]);
+        return 0;
+    }
+
+    printf("# threads\tinstances\tframes\tinstance_frames_per_second\tobservations\n");
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        // The console output of the ROM loading goes to stderr to keep the table clean
+        fflush(stdout);
+        console = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        env = create_vector_env(argv[optind], instances, threads);
+        fflush(stdout);
+        dup2(console, STDOUT_FILENO);
+        close(console);
+        if (preprocessing) {
+            enable_vector_preprocessing(env, &atari_spec, 4);
+        }
+
+        hash = run_batch(env, frames, &seconds);
+        if (threads == 1) {
+            reference = hash;
+        }
+        failed += hash != reference;
+        printf("%d\t%d\t%d\t%.0f\t%s\n", threads, instances, frames, (double)instances * frames / seconds,
+            hash == reference ? "ok" : "DIFFERENT");
+        if (threads == 1 && env->ram_map) {
+            game_state *game = &env->game_states[0];
+            printf("# instance 0: player %d score %u high score %u ships %d credits %d invaders %d\n", game->player,
+                game->score[game->player - 1], game->high_score, game->ships, game->credits, __builtin_popcountll(game->invaders));
+        }
+        destroy_vector_env(env);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    return failed ? 1 : 0;
+}